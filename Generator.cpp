@@ -0,0 +1,311 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <cmath>
+#include <cstdint>
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Генератор файлов с чеками в том же формате, что и 1.py:
+// "номер Товар цена количество, Товар цена количество, ..."
+
+// Быстрый генератор псевдослучайных чисел xoshiro256**, состояние заполняется через splitmix64
+class Random {
+public:
+    explicit Random(uint64_t seed) {
+        for (uint64_t& word : state) {
+            word = splitmix(seed);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    // Равномерное число из [0, n) без деления (умножение со сдвигом)
+    uint32_t below(uint32_t n) {
+        return static_cast<uint32_t>(((next() >> 32) * n) >> 32);
+    }
+
+    // Равномерное число из [0, 1)
+    double uniform() {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+    static uint64_t splitmix(uint64_t& x) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t state[4];
+};
+
+// Каталог товаров: название вместе с ценой хранится готовой строкой "Название цена "
+class Catalog {
+public:
+    // Первые товары совпадают с 1.py, остальные получают названия "ТоварN"
+    Catalog(size_t size, double skew) {
+        static const std::pair<const char*, const char*> base[] = {
+            {"Яблоко", "1.0"}, {"Банан", "0.5"}, {"Апельсин", "1.5"}, {"Киви", "2.0"},
+            {"Виноград", "3.0"}, {"Персик", "1.2"}, {"Лимон", "1.2"}, {"Груша", "1.1"},
+            {"Арбуз", "5.0"}, {"Дыня", "4.5"}, {"Слива", "2.0"}, {"Гранат", "3.0"},
+            {"Малина", "3.5"}, {"Черника", "4.0"}, {"Клубника", "2.5"}, {"Грейпфрут", "1.8"},
+            {"Манго", "2.8"}, {"Фейхоа", "3.2"}, {"Персик", "1.6"}, {"Апельсин", "2.1"}
+        };
+        for (size_t i = 0; i < size; ++i) {
+            if (i < std::size(base)) {
+                entries.push_back(std::string(base[i].first) + " " + base[i].second + " ");
+            } else {
+                size_t tenths = i % 99 + 1; // Цена от 0.1 до 9.9
+                entries.push_back("Товар" + std::to_string(i + 1) + " " + std::to_string(tenths / 10) + "." +
+                                  std::to_string(tenths % 10) + " ");
+            }
+        }
+
+        // При skew > 0 популярность товаров подчиняется закону Ципфа: вес k-го товара 1 / k^skew
+        if (skew > 0) {
+            cumulative.resize(size);
+            double sum = 0;
+            for (size_t i = 0; i < size; ++i) {
+                sum += 1.0 / std::pow(static_cast<double>(i + 1), skew);
+                cumulative[i] = sum;
+            }
+            for (double& value : cumulative) {
+                value /= sum;
+            }
+        }
+    }
+
+    const std::string& pick(Random& random) const {
+        if (cumulative.empty()) {
+            return entries[random.below(static_cast<uint32_t>(entries.size()))];
+        }
+        size_t index = std::upper_bound(cumulative.begin(), cumulative.end(), random.uniform()) - cumulative.begin();
+        return entries[std::min(index, entries.size() - 1)];
+    }
+
+private:
+    std::vector<std::string> entries;
+    std::vector<double> cumulative; // Накопленные вероятности для распределения Ципфа
+};
+
+const char* const usage =
+    "Использование: generator файл [--count N] [--start-id N] [--min-items N] [--max-items N]\n"
+    "                         [--max-quantity N] [--catalog N] [--zipf s] [--seed N] [--threads N]\n";
+
+// Параметры запуска (см. usage)
+struct Options {
+    std::string filename;
+    long long count = 1000000;    // Число чеков
+    long long startId = 1;        // Номер первого чека
+    uint32_t minItems = 1;        // Наименьшее число позиций в чеке
+    uint32_t maxItems = 5;        // Наибольшее число позиций в чеке
+    uint32_t maxQuantity = 10;    // Наибольшее количество товара в позиции
+    size_t catalogSize = 20;      // Число товаров в каталоге
+    double skew = 0;              // Параметр распределения Ципфа, 0 — равномерный выбор
+    uint64_t seed = 42;           // Зерно: один и тот же файл при любом числе потоков
+    int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    bool valid = true;            // Ложь, если в командной строке есть ошибка
+};
+
+// Число, занимающее всю строку text (std::from_chars: без пробелов и знака +)
+template <class T>
+bool parseNumber(std::string_view text, T& value) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+Options parseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        // Число из следующего аргумента, не меньше minimum (NaN тоже отвергается)
+        auto number = [&](auto& target, std::remove_reference_t<decltype(target)> minimum) {
+            const char* text = argv[++i];
+            std::remove_reference_t<decltype(target)> parsed;
+            if (!parseNumber(text, parsed) || !(parsed >= minimum)) {
+                std::cerr << "Неверное значение параметра " << arg << ": " << text << " (нужно число не меньше " << minimum << ")\n";
+                options.valid = false;
+            } else {
+                target = parsed;
+            }
+        };
+        bool takesValue = arg == "--count" || arg == "--start-id" || arg == "--min-items" || arg == "--max-items"
+            || arg == "--max-quantity" || arg == "--catalog" || arg == "--zipf" || arg == "--seed"
+            || arg == "--threads" || arg == "-t";
+        if (takesValue && i + 1 >= argc) {
+            std::cerr << "Не указано значение параметра " << arg << "\n";
+            options.valid = false;
+        } else if (arg == "--count") {
+            number(options.count, 0);
+        } else if (arg == "--start-id") {
+            number(options.startId, 0); // Номер чека не может быть отрицательным
+        } else if (arg == "--min-items") {
+            number(options.minItems, 1);
+        } else if (arg == "--max-items") {
+            number(options.maxItems, 1);
+        } else if (arg == "--max-quantity") {
+            number(options.maxQuantity, 1);
+        } else if (arg == "--catalog") {
+            number(options.catalogSize, 1);
+        } else if (arg == "--zipf") {
+            number(options.skew, 0);
+        } else if (arg == "--seed") {
+            number(options.seed, 0);
+        } else if (arg == "--threads" || arg == "-t") {
+            number(options.numThreads, 1);
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Неизвестный параметр: " << arg << "\n";
+            options.valid = false;
+        } else if (!options.filename.empty()) {
+            std::cerr << "Файл для записи уже указан: " << options.filename << "\n";
+            options.valid = false;
+        } else {
+            options.filename = arg;
+        }
+    }
+    options.maxItems = std::max(options.maxItems, options.minItems);
+    return options;
+}
+
+// Чеки генерируются блоками фиксированного размера. Зерно блока зависит только от его номера,
+// поэтому содержимое файла не зависит от числа потоков
+constexpr long long chunkReceipts = 65536;
+
+void appendNumber(std::string& buffer, long long value) {
+    char digits[24];
+    auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, end);
+}
+
+void generateChunk(const Options& options, const Catalog& catalog, long long chunk, std::string& buffer) {
+    uint64_t seed = options.seed ^ (static_cast<uint64_t>(chunk) * 0xd1b54a32d192ed03ULL);
+    Random random(Random::splitmix(seed));
+    long long first = chunk * chunkReceipts;
+    long long last = std::min(options.count, first + chunkReceipts);
+    uint32_t itemSpread = options.maxItems - options.minItems + 1;
+
+    buffer.clear();
+    for (long long receipt = first; receipt < last; ++receipt) {
+        appendNumber(buffer, options.startId + receipt);
+        buffer += ' ';
+        uint32_t items = options.minItems + random.below(itemSpread);
+        for (uint32_t item = 0; item < items; ++item) {
+            if (item > 0) {
+                buffer += ", ";
+            }
+            buffer += catalog.pick(random);
+            appendNumber(buffer, 1 + random.below(options.maxQuantity));
+        }
+        buffer += '\n';
+    }
+}
+
+bool writeAt(int fd, const std::string& buffer, off_t offset) {
+    size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t result = pwrite(fd, buffer.data() + written, buffer.size() - written, offset + written);
+        if (result <= 0) {
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+    if (options.valid && options.filename.empty()) {
+        std::cerr << "Не указан файл для записи чеков\n";
+        options.valid = false;
+    }
+    if (!options.valid) {
+        std::cerr << usage;
+        return 1;
+    }
+
+    int fd = open(options.filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Не удалось создать файл: " << options.filename << "\n";
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    Catalog catalog(options.catalogSize, options.skew);
+    long long chunks = (options.count + chunkReceipts - 1) / chunkReceipts;
+
+    // Блоки обрабатываются раундами: потоки заполняют свои буферы, затем по префиксным суммам
+    // длин вычисляются смещения, и каждый поток записывает свой буфер одним pwrite
+    size_t roundSize = static_cast<size_t>(options.numThreads);
+    std::vector<std::string> buffers(roundSize);
+    off_t offset = 0;
+    bool ok = true;
+    for (long long round = 0; round < chunks && ok; round += roundSize) {
+        size_t active = static_cast<size_t>(std::min<long long>(roundSize, chunks - round));
+        std::vector<off_t> offsets(active);
+        std::vector<char> failed(active, 0);
+
+        std::vector<std::thread> threads;
+        for (size_t index = 0; index < active; ++index) {
+            threads.emplace_back([&, index]() {
+                generateChunk(options, catalog, round + index, buffers[index]);
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        off_t next = offset;
+        for (size_t index = 0; index < active; ++index) {
+            offsets[index] = next;
+            next += buffers[index].size();
+        }
+
+        threads.clear();
+        for (size_t index = 0; index < active; ++index) {
+            threads.emplace_back([&, index]() {
+                failed[index] = !writeAt(fd, buffers[index], offsets[index]);
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        for (size_t index = 0; index < active; ++index) {
+            ok = ok && !failed[index];
+            offset += buffers[index].size();
+        }
+    }
+    close(fd);
+
+    if (!ok) {
+        std::cerr << "Ошибка записи файла: " << options.filename << "\n";
+        return 1;
+    }
+
+    std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "Создан файл " << options.filename << ": " << options.count << " чеков, "
+              << offset / (1024.0 * 1024.0) << " МБ за " << duration.count() << " секунд\n";
+    return 0;
+}
@@ -0,0 +1,604 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Среда выполнения на сопрограммах C++20 для заданий 1 и 3: много акторов (философов,
+// клиентов примитивов) выполняются на нескольких потоках ОС (M:N). Актор засыпает не на
+// потоке, а на ожидаемом примитиве или таймере, поэтому стоит только кадр сопрограммы
+namespace coro {
+
+class Scheduler;
+
+// Сколько байт занимают живые кадры сопрограмм (для оценки памяти на актор)
+inline std::atomic<long long> frame_bytes{0};
+
+// Кадры сопрограмм выделяются через operator new обещания: так их размер можно посчитать.
+// operator new не встраивается: иначе GCC видит кадр из ::operator new, освобождаемый
+// operator delete класса, и выдаёт ложное -Wmismatched-new-delete
+struct CountedFrame {
+    [[gnu::noinline]] static void* operator new(std::size_t size) {
+        frame_bytes.fetch_add(static_cast<long long>(size), std::memory_order_relaxed);
+        return ::operator new(size);
+    }
+
+    static void operator delete(void* frame, std::size_t size) {
+        frame_bytes.fetch_sub(static_cast<long long>(size), std::memory_order_relaxed);
+        ::operator delete(frame, size);
+    }
+};
+
+// Актор верхнего уровня: создаётся приостановленным, запускается Scheduler::spawn
+// и сам уничтожает свой кадр по завершении
+class Actor {
+public:
+    struct promise_type : CountedFrame {
+        Actor get_return_object() { return Actor(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept;
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Actor(Actor&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    Actor& operator=(Actor&& other) noexcept {
+        std::swap(handle, other.handle);
+        return *this;
+    }
+    ~Actor() {
+        if (handle) {
+            handle.destroy(); // актор так и не был запущен
+        }
+    }
+
+    // Передаёт владение кадром (планировщику)
+    std::coroutine_handle<> release() {
+        std::coroutine_handle<> result = handle;
+        handle = nullptr;
+        return result;
+    }
+
+private:
+    explicit Actor(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Вложенная сопрограмма: запускается при co_await и по завершении сразу (симметричной
+// передачей) возвращает управление ожидавшей, не проходя через очередь планировщика
+class Task {
+public:
+    struct promise_type : CountedFrame {
+        std::coroutine_handle<> continuation;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        auto final_suspend() noexcept {
+            struct Resume {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> self) noexcept {
+                    return self.promise().continuation;
+                }
+                void await_resume() noexcept {}
+            };
+            return Resume{};
+        }
+
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Task(Task&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    Task(const Task&) = delete;
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        handle.promise().continuation = caller;
+        return handle;
+    }
+    void await_resume() const noexcept {}
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Планировщик M:N: у каждого рабочего потока своя очередь готовых сопрограмм, свободный
+// поток забирает работу у других. Сопрограмма, разбуженная из рабочего потока, ставится
+// в его очередь (данные ещё в кеше); из внешнего потока — по кругу.
+// Отложенные пробуждения хранит колесо таймеров: ячейка на каждый тик, в ячейке —
+// сопрограммы с абсолютным сроком; колесо проворачивают свободные или раз в несколько
+// запусков занятые рабочие потоки
+class Scheduler {
+public:
+    explicit Scheduler(int num_workers, std::chrono::microseconds tick = std::chrono::microseconds(50))
+        : tick(tick), start(std::chrono::steady_clock::now()), wheel(wheel_slots) {
+        num_workers = num_workers < 1 ? 1 : num_workers;
+        for (int i = 0; i < num_workers; ++i) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (int i = 0; i < num_workers; ++i) {
+            workers.emplace_back([this, i]() { worker_loop(i); });
+        }
+    }
+
+    // Перед уничтожением нужно дождаться акторов (wait_all)
+    ~Scheduler() {
+        {
+            std::lock_guard<std::mutex> lock(idle_mtx);
+            stopping = true;
+        }
+        idle_cv.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    int size() const { return static_cast<int>(queues.size()); }
+
+    // Планировщик, на рабочем потоке которого выполняется текущая сопрограмма
+    static Scheduler& current() { return *current_scheduler; }
+
+    void spawn(Actor&& actor) {
+        live.fetch_add(1);
+        schedule(actor.release());
+    }
+
+    // Ждёт завершения всех запущенных акторов
+    void wait_all() {
+        std::unique_lock<std::mutex> lock(done_mtx);
+        done_cv.wait(lock, [this]() { return live.load() == 0; });
+    }
+
+    // Ставит сопрограмму в очередь готовых
+    void schedule(std::coroutine_handle<> handle) {
+        bool local = current_scheduler == this && current_worker >= 0;
+        Queue& queue = *queues[local ? current_worker : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mtx);
+            queue.tasks.push_back(handle);
+        }
+        queued.fetch_add(1); // счётчик и idle образуют пару Деккера: пробуждение не теряется
+        wake_idle();
+    }
+
+    // Разбудит сопрограмму не раньше чем через delay
+    void schedule_after(std::coroutine_handle<> handle, std::chrono::nanoseconds delay) {
+        uint64_t ticks = static_cast<uint64_t>((delay + tick - std::chrono::nanoseconds(1)) / tick);
+        {
+            std::lock_guard<std::mutex> lock(timer_mtx);
+            uint64_t deadline = current_tick() + ticks;
+            if (ticks > 0 && deadline > last_tick) {
+                wheel[deadline % wheel_slots].push_back({handle, deadline});
+                timers_pending.fetch_add(1);
+                handle = nullptr;
+            }
+        }
+        if (handle) {
+            schedule(handle);
+        } else {
+            wake_idle(); // спящий поток должен перейти на ожидание с таймаутом
+        }
+    }
+
+    // Сколько раз сопрограммы были запущены из очереди (переключения контекста)
+    uint64_t switches() const {
+        uint64_t total = 0;
+        for (const auto& queue : queues) {
+            total += queue->switches.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    void task_done() {
+        if (live.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(done_mtx);
+            done_cv.notify_all();
+        }
+    }
+
+private:
+    static constexpr size_t wheel_slots = 4096;
+    static constexpr int timer_check_interval = 16; // Запусков между проверками колеса
+
+    struct alignas(64) Queue {
+        std::mutex mtx;
+        std::deque<std::coroutine_handle<>> tasks;
+        std::atomic<uint64_t> switches{0};
+    };
+
+    struct Timer {
+        std::coroutine_handle<> handle;
+        uint64_t deadline; // Тик, начиная с которого сопрограмму можно будить
+    };
+
+    void worker_loop(int index) {
+        current_scheduler = this;
+        current_worker = index;
+        int until_timers = timer_check_interval;
+        while (true) {
+            std::coroutine_handle<> handle;
+            if (--until_timers == 0) {
+                until_timers = timer_check_interval;
+                advance_timers();
+            }
+            if (take(index, handle)) {
+                queues[index]->switches.fetch_add(1, std::memory_order_relaxed);
+                handle.resume();
+                continue;
+            }
+            if (advance_timers()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(idle_mtx);
+            if (stopping) {
+                return;
+            }
+            idle.fetch_add(1);
+            if (queued.load() == 0) {
+                if (timers_pending.load() > 0) {
+                    idle_cv.wait_for(lock, tick);
+                } else {
+                    idle_cv.wait(lock);
+                }
+            }
+            idle.fetch_sub(1);
+        }
+    }
+
+    // Своя очередь — с начала (порядок FIFO), чужие — с конца
+    bool take(int index, std::coroutine_handle<>& handle) {
+        for (size_t i = 0; i < queues.size(); ++i) {
+            Queue& queue = *queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mtx);
+            if (!queue.tasks.empty()) {
+                if (i == 0) {
+                    handle = queue.tasks.front();
+                    queue.tasks.pop_front();
+                } else {
+                    handle = queue.tasks.back();
+                    queue.tasks.pop_back();
+                }
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Будит сопрограммы, срок которых наступил; колесо проворачивает один поток за раз
+    bool advance_timers() {
+        if (timers_pending.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        std::unique_lock<std::mutex> lock(timer_mtx, std::try_to_lock);
+        if (!lock) {
+            return false;
+        }
+        uint64_t now = current_tick();
+        if (now == last_tick) {
+            return false;
+        }
+        // Если прошло больше оборота, достаточно один раз пройти все ячейки
+        uint64_t steps = now - last_tick < wheel_slots ? now - last_tick : wheel_slots;
+        bool fired = false;
+        for (uint64_t step = 1; step <= steps; ++step) {
+            std::vector<Timer>& slot = wheel[(last_tick + step) % wheel_slots];
+            for (size_t i = 0; i < slot.size();) {
+                if (slot[i].deadline <= now) {
+                    schedule(slot[i].handle);
+                    timers_pending.fetch_sub(1);
+                    slot[i] = slot.back();
+                    slot.pop_back();
+                    fired = true;
+                } else {
+                    ++i;
+                }
+            }
+        }
+        last_tick = now;
+        return fired;
+    }
+
+    uint64_t current_tick() const {
+        return static_cast<uint64_t>((std::chrono::steady_clock::now() - start) / tick);
+    }
+
+    void wake_idle() {
+        if (idle.load() > 0) {
+            std::lock_guard<std::mutex> lock(idle_mtx);
+            idle_cv.notify_one();
+        }
+    }
+
+    static inline thread_local Scheduler* current_scheduler = nullptr;
+    static inline thread_local int current_worker = -1;
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next_queue{0};
+    std::atomic<size_t> queued{0}; // Готовых сопрограмм во всех очередях
+    std::atomic<int> idle{0};      // Сколько потоков спит
+    std::mutex idle_mtx;
+    std::condition_variable idle_cv;
+    bool stopping = false;
+
+    std::chrono::nanoseconds tick;
+    std::chrono::steady_clock::time_point start;
+    std::mutex timer_mtx;
+    std::vector<std::vector<Timer>> wheel;
+    uint64_t last_tick = 0;
+    std::atomic<size_t> timers_pending{0};
+
+    std::atomic<long> live{0}; // Незавершённые акторы
+    std::mutex done_mtx;
+    std::condition_variable done_cv;
+};
+
+inline auto Actor::promise_type::final_suspend() noexcept {
+    struct Finish {
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<promise_type> self) noexcept {
+            Scheduler& scheduler = Scheduler::current();
+            self.destroy();
+            scheduler.task_done();
+        }
+        void await_resume() noexcept {}
+    };
+    return Finish{};
+}
+
+// co_await sleep_for(...) — заснуть на таймере, не занимая поток
+inline auto sleep_for(std::chrono::nanoseconds delay) {
+    struct Sleep {
+        std::chrono::nanoseconds delay;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { Scheduler::current().schedule_after(handle, delay); }
+        void await_resume() const noexcept {}
+    };
+    return Sleep{delay};
+}
+
+// co_await yield() — уступить поток другим готовым сопрограммам
+inline auto yield() {
+    struct Yield {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { Scheduler::current().schedule(handle); }
+        void await_resume() const noexcept {}
+    };
+    return Yield{};
+}
+
+// Очередь ожидающих без выделения памяти: узлы живут в кадрах ожидающих сопрограмм
+struct Waiter {
+    std::coroutine_handle<> handle;
+    Waiter* next = nullptr;
+};
+
+class WaiterList {
+public:
+    bool empty() const { return head == nullptr; }
+
+    void push(Waiter* waiter) {
+        waiter->next = nullptr;
+        (tail ? tail->next : head) = waiter;
+        tail = waiter;
+    }
+
+    Waiter* pop() {
+        Waiter* waiter = head;
+        head = waiter->next;
+        if (!head) {
+            tail = nullptr;
+        }
+        return waiter;
+    }
+
+private:
+    Waiter* head = nullptr;
+    Waiter* tail = nullptr;
+};
+
+// Мьютекс для сопрограмм: co_await mutex.lock(). Ожидающие выстраиваются в очередь (FIFO),
+// и unlock передаёт владение первому из них, не отпуская мьютекс
+class AsyncMutex {
+public:
+    auto lock() {
+        struct Lock : Waiter {
+            AsyncMutex& mutex;
+            explicit Lock(AsyncMutex& mutex) : mutex(mutex) {}
+            bool await_ready() { return mutex.try_lock(); }
+            bool await_suspend(std::coroutine_handle<> handle) {
+                std::lock_guard<std::mutex> guard(mutex.guard);
+                if (!mutex.locked) {
+                    mutex.locked = true;
+                    return false;
+                }
+                this->handle = handle;
+                mutex.waiters.push(this);
+                return true;
+            }
+            void await_resume() const noexcept {}
+        };
+        return Lock(*this);
+    }
+
+    bool try_lock() {
+        std::lock_guard<std::mutex> guard(this->guard);
+        if (locked) {
+            return false;
+        }
+        locked = true;
+        return true;
+    }
+
+    void unlock() {
+        Waiter* next = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(this->guard);
+            if (waiters.empty()) {
+                locked = false;
+                return;
+            }
+            next = waiters.pop();
+        }
+        Scheduler::current().schedule(next->handle);
+    }
+
+private:
+    std::mutex guard; // Защищает поля на время нескольких инструкций
+    bool locked = false;
+    WaiterList waiters;
+};
+
+// Семафор для сопрограмм: co_await semaphore.acquire(); release передаёт разрешение
+// первому ожидающему, а если ожидающих нет — увеличивает счётчик
+class AsyncSemaphore {
+public:
+    explicit AsyncSemaphore(long count) : count(count) {}
+
+    auto acquire() {
+        struct Acquire : Waiter {
+            AsyncSemaphore& semaphore;
+            explicit Acquire(AsyncSemaphore& semaphore) : semaphore(semaphore) {}
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle) {
+                std::lock_guard<std::mutex> guard(semaphore.guard);
+                if (semaphore.count > 0) {
+                    --semaphore.count;
+                    return false;
+                }
+                this->handle = handle;
+                semaphore.waiters.push(this);
+                return true;
+            }
+            void await_resume() const noexcept {}
+        };
+        return Acquire(*this);
+    }
+
+    void release() {
+        Waiter* next = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(this->guard);
+            if (waiters.empty()) {
+                ++count;
+                return;
+            }
+            next = waiters.pop();
+        }
+        Scheduler::current().schedule(next->handle);
+    }
+
+private:
+    std::mutex guard;
+    long count;
+    WaiterList waiters;
+};
+
+// Барьер для сопрограмм: co_await barrier.arrive_and_wait(); последний из участников
+// будит остальных и продолжает работу без приостановки
+class AsyncBarrier {
+public:
+    explicit AsyncBarrier(long participants) : participants(participants) {}
+
+    auto arrive_and_wait() {
+        struct Arrive : Waiter {
+            AsyncBarrier& barrier;
+            explicit Arrive(AsyncBarrier& barrier) : barrier(barrier) {}
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle) {
+                WaiterList ready;
+                {
+                    std::lock_guard<std::mutex> guard(barrier.guard);
+                    if (++barrier.arrived < barrier.participants) {
+                        this->handle = handle;
+                        barrier.waiters.push(this);
+                        return true;
+                    }
+                    barrier.arrived = 0;
+                    std::swap(ready, barrier.waiters);
+                }
+                while (!ready.empty()) {
+                    Scheduler::current().schedule(ready.pop()->handle);
+                }
+                return false;
+            }
+            void await_resume() const noexcept {}
+        };
+        return Arrive(*this);
+    }
+
+private:
+    std::mutex guard;
+    long participants;
+    long arrived = 0;
+    WaiterList waiters;
+};
+
+// Monitor и SemaphoreSlim из задания 1 в виде для сопрограмм: тот же интерфейс
+// enter/exit и wait/release, ожидание — приостановкой сопрограммы
+class AsyncMonitor {
+public:
+    auto enter() { return mutex.lock(); }
+    void exit() { mutex.unlock(); }
+
+private:
+    AsyncMutex mutex;
+};
+
+class AsyncSemaphoreSlim {
+public:
+    explicit AsyncSemaphoreSlim(long count) : semaphore(count) {}
+
+    auto wait() { return semaphore.acquire(); }
+    void release() { semaphore.release(); }
+
+private:
+    AsyncSemaphore semaphore;
+};
+
+// Замеры для сравнения с потоком на актор: резидентная память процесса и
+// переключения контекста потоков ОС (добровольные и вынужденные)
+inline long long resident_bytes() {
+    long long pages = 0;
+    long long resident = 0;
+    if (FILE* file = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(file, "%lld %lld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        std::fclose(file);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+inline long long os_context_switches() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+} // namespace coro
@@ -8,6 +8,19 @@
 #include <chrono>
 #include <vector>
 #include <random>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
+#include <charconv>
+#include <cstring>
+
+#include "Runtime.h"
 
 using namespace std;
 
@@ -25,10 +38,45 @@ char generate_random_char() {
 }
 
 
-//  Monitor
-class Monitor {
+// Размер кеш-линии: данные разных потоков разносятся по разным линиям
+constexpr size_t cache_line = 64;
+
+// Подсказка процессору, что поток крутится в цикле ожидания
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    this_thread::yield();
+#endif
+}
+
+// Ожидание в цикле: сначала пауза процессора, а после долгого ожидания — уступка
+// процессора, чтобы не тратить квант времени, когда владелец лока вытеснен
+class SpinBackoff {
 public:
-    Monitor() : flag(false) {} // конструктор,который создает доступный монитор
+    void pause(int relax = 1) {
+        if (spins < spin_limit) {
+            relax = min(relax, spin_limit - spins);
+            spins += relax;
+            for (int i = 0; i < relax; ++i) {
+                cpu_relax();
+            }
+        } else {
+            this_thread::yield();
+        }
+    }
+
+private:
+    static constexpr int spin_limit = 4096; // Сколько пауз процессора сделать до первой уступки
+    int spins = 0;
+};
+
+//  Monitor на мьютексе и условной переменной (исходная реализация, оставлена для сравнения)
+class BlockingMonitor {
+public:
+    BlockingMonitor() : flag(false) {} // конструктор,который создает доступный монитор
 
     // Метод для захвата монитора
     void enter() {
@@ -52,6 +100,49 @@ private:
     condition_variable cond; //переменная для уведомления потоков
 };
 
+//  Monitor с быстрым путём: свободный монитор захватывается одной атомарной операцией,
+//  занятый — после короткого ожидания в цикле, а затем поток засыпает на futex
+//  (atomic::wait). Будятся потоки только если кто-то действительно ждёт
+class Monitor {
+public:
+    Monitor() : state(free) {} // конструктор,который создает доступный монитор
+
+    // Метод для захвата монитора
+    void enter() {
+        int expected = free;
+        if (state.compare_exchange_strong(expected, locked, memory_order_acquire, memory_order_relaxed)) {
+            return; // монитор был свободен
+        }
+        for (int i = 0; i < spin_limit; ++i) { // владелец часто освобождает монитор очень скоро
+            cpu_relax();
+            expected = free;
+            if (state.load(memory_order_relaxed) == free &&
+                state.compare_exchange_weak(expected, locked, memory_order_acquire, memory_order_relaxed)) {
+                return;
+            }
+        }
+        // Отмечаем, что есть ожидающие, и засыпаем, пока монитор занят
+        while (state.exchange(contended, memory_order_acquire) != free) {
+            state.wait(contended, memory_order_relaxed);
+        }
+    }
+
+    // Метод для освобождения монитора
+    void exit() {
+        if (state.exchange(free, memory_order_release) == contended) {
+            state.notify_one(); // будим один поток, только если кто-то ждёт
+        }
+    }
+
+private:
+    static constexpr int free = 0;      // монитор свободен
+    static constexpr int locked = 1;    // монитор занят, ожидающих нет
+    static constexpr int contended = 2; // монитор занят, возможно есть ожидающие
+    static constexpr int spin_limit = 100;
+
+    atomic<int> state;
+};
+
 void test_monitor(int num_threads) {
     cout << "Тестирование Monitor:" << endl;
 
@@ -85,10 +176,10 @@ void test_monitor(int num_threads) {
 
 
 
-//  SemaphoreSlim
-class SemaphoreSlim {
+//  SemaphoreSlim на мьютексе и условной переменной (исходная реализация, оставлена для сравнения)
+class BlockingSemaphoreSlim {
 public:
-    SemaphoreSlim(int count) : count(count) {}
+    BlockingSemaphoreSlim(int count) : count(count) {}
 
     // Метод для захвата семафора
     void wait() {
@@ -112,6 +203,54 @@ private:
     condition_variable cond;
 };
 
+//  SemaphoreSlim с быстрым путём: счётчик уменьшается атомарной операцией (CAS),
+//  при нулевом счётчике поток недолго ждёт в цикле, а затем засыпает на futex.
+//  release будит поток, только если есть зарегистрированные ожидающие
+class SemaphoreSlim {
+public:
+    SemaphoreSlim(int count) : count(count), waiters(0) {}
+
+    // Метод для захвата семафора
+    void wait() {
+        for (int i = 0; i < spin_limit; ++i) {
+            if (try_acquire()) {
+                return;
+            }
+            cpu_relax();
+        }
+        waiters.fetch_add(1); // регистрируемся до проверки счётчика, чтобы не пропустить release
+        while (!try_acquire()) {
+            count.wait(0); // спим, пока счётчик равен нулю
+        }
+        waiters.fetch_sub(1, memory_order_relaxed);
+    }
+
+    // Метод для освобождения семафора
+    void release() {
+        count.fetch_add(1);
+        if (waiters.load() > 0) {
+            count.notify_one(); // Уведомляем один поток, что ресурс свободен
+        }
+    }
+
+private:
+    // Уменьшает счётчик, если он больше нуля
+    bool try_acquire() {
+        int current = count.load(memory_order_relaxed);
+        while (current > 0) {
+            if (count.compare_exchange_weak(current, current - 1, memory_order_acquire, memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static constexpr int spin_limit = 100;
+
+    atomic<int> count;   // сколько потоков могут использовать ресурс
+    atomic<int> waiters; // сколько потоков спит в ожидании ресурса
+};
+
 
 // Тестирование SemaphoreSlim
 void test_semaphore_slim(int num_threads) {
@@ -146,6 +285,184 @@ void test_semaphore_slim(int num_threads) {
     cout << "---------------------------------" << endl;
 }
 
+// Test-and-test-and-set спинлок с экспоненциальной задержкой: ожидающие потоки
+// читают флаг из своего кеша и пытаются его захватить только когда он свободен
+class TTASLock {
+public:
+    void lock() {
+        int delay = 1;
+        SpinBackoff backoff;
+        while (true) {
+            if (!locked.exchange(true, memory_order_acquire)) {
+                return;
+            }
+            while (locked.load(memory_order_relaxed)) {
+                backoff.pause(delay);
+                delay = min(delay * 2, max_delay); // удваиваем паузу, чтобы не толкаться на одной линии
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !locked.load(memory_order_relaxed) && !locked.exchange(true, memory_order_acquire);
+    }
+
+    void unlock() {
+        locked.store(false, memory_order_release);
+    }
+
+private:
+    static constexpr int max_delay = 1024;
+    alignas(cache_line) atomic<bool> locked{false};
+    char padding[cache_line - sizeof(atomic<bool>)];
+};
+
+// Билетный спинлок: потоки получают лок строго в порядке очереди (FIFO).
+// Если потоков больше, чем ядер, лок ждёт, пока планировщик запустит именно
+// следующий по очереди поток, поэтому пропускная способность резко падает
+class TicketLock {
+public:
+    void lock() {
+        uint32_t ticket = next_ticket.fetch_add(1, memory_order_relaxed); // берём номерок
+        SpinBackoff backoff;
+        while (true) {
+            uint32_t current = now_serving.load(memory_order_acquire);
+            if (current == ticket) {
+                return;
+            }
+            backoff.pause(static_cast<int>(ticket - current) * 32); // пауза пропорциональна длине очереди впереди
+        }
+    }
+
+    bool try_lock() {
+        uint32_t current = now_serving.load(memory_order_relaxed);
+        uint32_t expected = current;
+        return next_ticket.compare_exchange_strong(expected, current + 1, memory_order_acquire, memory_order_relaxed);
+    }
+
+    void unlock() {
+        now_serving.store(now_serving.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+private:
+    alignas(cache_line) atomic<uint32_t> next_ticket{0}; // Следующий выдаваемый номерок
+    alignas(cache_line) atomic<uint32_t> now_serving{0}; // Номерок владельца лока
+    char padding[cache_line - sizeof(atomic<uint32_t>)];
+};
+
+// MCS-лок: ожидающие потоки выстраиваются в очередь, и каждый крутится на флаге
+// в своём узле, поэтому при передаче лока меняется только одна кеш-линия.
+// Как и билетный лок, честен (FIFO) и плохо переносит потоков больше, чем ядер
+class MCSLock {
+public:
+    void lock() {
+        Node* node = acquire_node();
+        node->next.store(nullptr, memory_order_relaxed);
+        node->waiting.store(true, memory_order_relaxed);
+        Node* prev = tail.exchange(node, memory_order_acq_rel); // встаём в конец очереди
+        if (prev) {
+            prev->next.store(node, memory_order_release);
+            SpinBackoff backoff;
+            while (node->waiting.load(memory_order_acquire)) {
+                backoff.pause();
+            }
+        }
+        holder = node;
+    }
+
+    bool try_lock() {
+        Node* node = acquire_node();
+        node->next.store(nullptr, memory_order_relaxed);
+        Node* expected = nullptr;
+        if (tail.compare_exchange_strong(expected, node, memory_order_acq_rel, memory_order_relaxed)) {
+            holder = node;
+            return true;
+        }
+        release_node(node);
+        return false;
+    }
+
+    void unlock() {
+        Node* node = holder;
+        Node* next = node->next.load(memory_order_acquire);
+        if (!next) {
+            Node* expected = node;
+            if (tail.compare_exchange_strong(expected, nullptr, memory_order_acq_rel, memory_order_relaxed)) {
+                release_node(node); // очередь пуста
+                return;
+            }
+            // Следующий поток уже встал в очередь, но ещё не записал себя в next
+            SpinBackoff backoff;
+            while (!(next = node->next.load(memory_order_acquire))) {
+                backoff.pause();
+            }
+        }
+        next->waiting.store(false, memory_order_release); // передаём лок следующему
+        release_node(node);
+    }
+
+private:
+    struct alignas(cache_line) Node {
+        atomic<Node*> next{nullptr};
+        atomic<bool> waiting{false};
+    };
+
+    // Узлы берутся из запаса потока, поэтому поток может держать несколько MCS-локов сразу
+    static vector<unique_ptr<Node>>& free_nodes() {
+        thread_local vector<unique_ptr<Node>> nodes;
+        return nodes;
+    }
+
+    static Node* acquire_node() {
+        auto& nodes = free_nodes();
+        if (nodes.empty()) {
+            return new Node();
+        }
+        Node* node = nodes.back().release();
+        nodes.pop_back();
+        return node;
+    }
+
+    static void release_node(Node* node) {
+        free_nodes().emplace_back(node);
+    }
+
+    alignas(cache_line) atomic<Node*> tail{nullptr}; // Последний поток в очереди
+    Node* holder = nullptr; // Узел владельца лока (меняется только владельцем)
+    char padding[cache_line - sizeof(atomic<Node*>) - sizeof(Node*)];
+};
+
+// Тестирование спинлока из семейства TTAS/Ticket/MCS через lock_guard
+template <typename Lock>
+void test_lock(const string& name, int num_threads) {
+    cout << "Тестирование " << name << ":" << endl;
+
+    Lock lock;
+    vector<thread> threads;
+
+    auto start = chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < num_threads; ++i) {
+        threads.push_back(thread([i, &lock, &name]() {
+            lock_guard<Lock> guard(lock);
+            {
+                lock_guard<mutex> out(mtx);
+                char c = generate_random_char();
+                cout << "Поток " << i << ": " << c << " (" << name << ")" << endl;
+            }
+        }));
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> duration = end - start;
+    cout << "Время работы " << name << ": " << duration.count() << " секунд." << endl;
+    cout << "---------------------------------" << endl;
+}
+
 void test_mutex(int num_threads) {
     cout << "Тестирование мьютекса:" << endl;
 
@@ -296,8 +613,1156 @@ void test_spinwait(int num_threads) {
 }
 
 
+// ---------------------------------------------------------------------------
+// Нагрузочное тестирование примитивов: много захватов и освобождений в каждом
+// потоке, перебор числа потоков и длины критической секции, гистограмма
+// задержек захвата. Запуск: ./zad1 --bench [параметры]
+// ---------------------------------------------------------------------------
+
+// Гистограмма задержек в наносекундах с логарифмически-линейными корзинами:
+// значения до 16 хранятся точно, дальше каждая степень двойки делится на 16 корзин
+// (относительная погрешность не больше 1/16)
+class LatencyHistogram {
+public:
+    LatencyHistogram() : buckets(bucket_count, 0) {}
+
+    void record(uint64_t ns) {
+        ++buckets[bucket_index(ns)];
+        ++total;
+        max_value = max(max_value, ns);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            buckets[i] += other.buckets[i];
+        }
+        total += other.total;
+        max_value = max(max_value, other.max_value);
+    }
+
+    // Значение, не меньше которого доля p измерений (p от 0 до 1): наибольшее значение
+    // корзины, в которую попал нужный ранг (не больше максимума измерений)
+    uint64_t percentile(double p) const {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(p * (total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return min(bucket_upper(i), max_value);
+            }
+        }
+        return max_value;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max_ns() const { return max_value; }
+
+private:
+    static constexpr int sub_bits = 4;
+    static constexpr size_t bucket_count = (64 - sub_bits + 1) << sub_bits;
+
+    static size_t bucket_index(uint64_t v) {
+        if (v < (1u << sub_bits)) {
+            return static_cast<size_t>(v);
+        }
+        int exponent = 63 - __builtin_clzll(v);
+        uint64_t sub = (v >> (exponent - sub_bits)) & ((1u << sub_bits) - 1);
+        return static_cast<size_t>((exponent - sub_bits + 1) << sub_bits) + sub;
+    }
+
+    // Наибольшее значение, попадающее в корзину (граница включительно)
+    static uint64_t bucket_upper(size_t index) {
+        if (index < (1u << sub_bits)) {
+            return index;
+        }
+        int exponent = static_cast<int>(index >> sub_bits) + sub_bits - 1;
+        uint64_t sub = index & ((1u << sub_bits) - 1);
+        return (((uint64_t{1} << sub_bits | sub) + 1) << (exponent - sub_bits)) - 1;
+    }
+
+    vector<uint64_t> buckets;
+    uint64_t total = 0;
+    uint64_t max_value = 0;
+};
+
+// Работа внутри критической секции: units итераций, которые компилятор не может выбросить
+inline void critical_work(int units) {
+    for (int i = 0; i < units; ++i) {
+        asm volatile("" ::: "memory");
+    }
+}
+
+// Единый интерфейс lock/unlock для всех примитивов
+
+struct MutexAdapter {
+    mutex m;
+    void lock() { m.lock(); }
+    void unlock() { m.unlock(); }
+};
+
+// Семафор со счётчиком 1, чтобы сравнение со взаимным исключением было честным
+struct SemaphoreAdapter {
+    counting_semaphore<1> sem{1};
+    void lock() { sem.acquire(); }
+    void unlock() { sem.release(); }
+};
+
+// Спинлок как в test_spinlock: test_and_set в цикле
+struct SpinLockAdapter {
+    atomic_flag flag = ATOMIC_FLAG_INIT;
+    void lock() { while (flag.test_and_set()) { /* активно ждём */ } }
+    void unlock() { flag.clear(); }
+};
+
+// SpinWait как в test_spinwait: test_and_set с уступкой процессора
+struct SpinWaitAdapter {
+    atomic_flag flag = ATOMIC_FLAG_INIT;
+    void lock() {
+        while (flag.test_and_set()) {
+            this_thread::yield();
+        }
+    }
+    void unlock() { flag.clear(); }
+};
+
+struct MonitorAdapter {
+    Monitor monitor;
+    void lock() { monitor.enter(); }
+    void unlock() { monitor.exit(); }
+};
+
+struct SemaphoreSlimAdapter {
+    SemaphoreSlim sem{1};
+    void lock() { sem.wait(); }
+    void unlock() { sem.release(); }
+};
+
+struct BlockingMonitorAdapter {
+    BlockingMonitor monitor;
+    void lock() { monitor.enter(); }
+    void unlock() { monitor.exit(); }
+};
+
+struct BlockingSemaphoreSlimAdapter {
+    BlockingSemaphoreSlim sem{1};
+    void lock() { sem.wait(); }
+    void unlock() { sem.release(); }
+};
+
+// Параметры нагрузочного тестирования
+struct BenchOptions {
+    vector<int> thread_counts;              // Перебираемые числа потоков
+    vector<int> cs_lengths = {0, 100, 1000}; // Длина критической секции (итераций работы)
+    long iterations = 1000000;              // Захватов на поток
+    vector<string> only;                    // Тестировать только эти примитивы (пусто — все)
+    string csv_file;                        // Куда сохранить результаты в CSV
+    string json_file;                       // Куда сохранить результаты в JSON
+    bool valid = true;                      // Ложь, если в командной строке есть ошибка
+};
+
+// Результат одного прогона
+struct BenchResult {
+    string primitive;
+    int threads = 0;
+    int cs_length = 0;
+    long iterations = 0;    // Захватов на поток
+    double seconds = 0;     // Время прогона
+    double ops_per_sec = 0; // Захватов в секунду по всем потокам
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    uint64_t max_ns = 0;
+    bool correct = true;    // Совпал ли счётчик, защищённый примитивом
+};
+
+// Запуск потоков, которые одновременно начинают body(поток, гистограмма)
+// после общего сигнала; возвращает время от сигнала до завершения всех потоков
+double run_threads(int num_threads, const function<void(int, LatencyHistogram&)>& body, LatencyHistogram& merged) {
+    vector<LatencyHistogram> histograms(num_threads);
+    atomic<int> ready{0};
+    atomic<bool> go{false};
+    vector<thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&, i]() {
+            ready.fetch_add(1);
+            while (!go.load(memory_order_acquire)) {
+                this_thread::yield();
+            }
+            body(i, histograms[i]);
+        });
+    }
+    while (ready.load() != num_threads) {
+        this_thread::yield();
+    }
+    auto start = chrono::steady_clock::now();
+    go.store(true, memory_order_release);
+    for (auto& t : threads) {
+        t.join();
+    }
+    chrono::duration<double> duration = chrono::steady_clock::now() - start;
+    for (const auto& h : histograms) {
+        merged.merge(h);
+    }
+    return duration.count();
+}
+
+BenchResult make_result(const string& name, int num_threads, int cs_length, long iterations, double seconds, const LatencyHistogram& histogram) {
+    BenchResult result;
+    result.primitive = name;
+    result.threads = num_threads;
+    result.cs_length = cs_length;
+    result.iterations = iterations;
+    result.seconds = seconds;
+    result.ops_per_sec = seconds > 0 ? num_threads * static_cast<double>(iterations) / seconds : 0;
+    result.p50_ns = histogram.percentile(0.5);
+    result.p99_ns = histogram.percentile(0.99);
+    result.p999_ns = histogram.percentile(0.999);
+    result.max_ns = histogram.max_ns();
+    return result;
+}
+
+// Прогон для примитива взаимного исключения: замеряется задержка каждого захвата
+template <typename Lock>
+BenchResult bench_lock(const string& name, int num_threads, int cs_length, long iterations) {
+    Lock lock;
+    long counter = 0; // Защищён примитивом: итог должен равняться потоки * итерации
+    LatencyHistogram histogram;
+    double seconds = run_threads(num_threads, [&](int, LatencyHistogram& h) {
+        for (long i = 0; i < iterations; ++i) {
+            auto t0 = chrono::steady_clock::now();
+            lock.lock();
+            auto t1 = chrono::steady_clock::now();
+            ++counter;
+            critical_work(cs_length);
+            lock.unlock();
+            h.record(chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count());
+        }
+    }, histogram);
+    BenchResult result = make_result(name, num_threads, cs_length, iterations, seconds, histogram);
+    result.correct = counter == num_threads * iterations;
+    return result;
+}
+
+// Прогон для барьера: замеряется время ожидания в arrive_and_wait
+BenchResult bench_barrier(int num_threads, int cs_length, long iterations) {
+    barrier bar(num_threads);
+    LatencyHistogram histogram;
+    double seconds = run_threads(num_threads, [&](int, LatencyHistogram& h) {
+        for (long i = 0; i < iterations; ++i) {
+            critical_work(cs_length);
+            auto t0 = chrono::steady_clock::now();
+            bar.arrive_and_wait();
+            h.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count());
+        }
+    }, histogram);
+    return make_result("barrier", num_threads, cs_length, iterations, seconds, histogram);
+}
+
+// Список тестируемых примитивов: название и функция прогона
+vector<pair<string, function<BenchResult(const string&, int, int, long)>>> bench_primitives() {
+    return {
+        {"mutex", bench_lock<MutexAdapter>},
+        {"semaphore", bench_lock<SemaphoreAdapter>},
+        {"spinlock", bench_lock<SpinLockAdapter>},
+        {"spinwait", bench_lock<SpinWaitAdapter>},
+        {"monitor", bench_lock<MonitorAdapter>},
+        {"semaphore_slim", bench_lock<SemaphoreSlimAdapter>},
+        {"monitor_cv", bench_lock<BlockingMonitorAdapter>},
+        {"semaphore_slim_cv", bench_lock<BlockingSemaphoreSlimAdapter>},
+        {"ttas", bench_lock<TTASLock>},
+        {"ticket", bench_lock<TicketLock>},
+        {"mcs", bench_lock<MCSLock>},
+        // Барьер заставляет все потоки встречаться на каждой итерации, поэтому итераций меньше
+        {"barrier", [](const string&, int threads, int cs, long iterations) { return bench_barrier(threads, cs, max(1000L, iterations / 100)); }},
+    };
+}
+
+void write_csv(const string& filename, const vector<BenchResult>& results) {
+    ofstream out(filename);
+    out << "primitive,threads,cs_length,iterations,seconds,ops_per_sec,p50_ns,p99_ns,p999_ns,max_ns,correct\n";
+    for (const auto& r : results) {
+        out << r.primitive << ',' << r.threads << ',' << r.cs_length << ',' << r.iterations << ',' << r.seconds << ','
+            << r.ops_per_sec << ',' << r.p50_ns << ',' << r.p99_ns << ',' << r.p999_ns << ',' << r.max_ns << ','
+            << (r.correct ? "true" : "false") << '\n';
+    }
+}
+
+void write_json(const string& filename, const vector<BenchResult>& results) {
+    ofstream out(filename);
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        out << "  {\"primitive\": \"" << r.primitive << "\", \"threads\": " << r.threads << ", \"cs_length\": " << r.cs_length
+            << ", \"iterations\": " << r.iterations << ", \"seconds\": " << r.seconds << ", \"ops_per_sec\": " << r.ops_per_sec
+            << ", \"p50_ns\": " << r.p50_ns << ", \"p99_ns\": " << r.p99_ns << ", \"p999_ns\": " << r.p999_ns
+            << ", \"max_ns\": " << r.max_ns << ", \"correct\": " << (r.correct ? "true" : "false") << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+// Разбор целого числа: строка должна быть числом целиком и не меньше minimum
+template <class T>
+bool parse_number(const string& text, T& value, T minimum) {
+    T result{};
+    auto [end, error] = from_chars(text.data(), text.data() + text.size(), result);
+    if (error != errc() || end != text.data() + text.size() || result < minimum) {
+        return false;
+    }
+    value = result;
+    return true;
+}
+
+// Разбор списка чисел через запятую: "1,2,4"
+bool parse_int_list(const string& text, vector<int>& values, int minimum) {
+    vector<int> parsed;
+    size_t start = 0;
+    while (true) {
+        size_t comma = text.find(',', start);
+        int value = 0;
+        if (!parse_number(text.substr(start, comma - start), value, minimum)) {
+            return false;
+        }
+        parsed.push_back(value);
+        if (comma == string::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    values = move(parsed);
+    return true;
+}
+
+// Разбор списка слов через запятую
+vector<string> parse_name_list(const string& text) {
+    vector<string> values;
+    stringstream ss(text);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(item);
+        }
+    }
+    return values;
+}
+
+// Разбор параметров вида "--имя значение", начиная с argv[2]. Обработчик параметра разбирает
+// значение и возвращает false, если оно неверное. Ошибки печатаются в cerr; результат — не было ли их
+bool parse_option_list(int argc, char* argv[], initializer_list<pair<const char*, function<bool(const string&)>>> handlers) {
+    bool valid = true;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        auto handler = find_if(handlers.begin(), handlers.end(), [&](const auto& h) { return arg == h.first; });
+        if (handler == handlers.end()) {
+            cerr << "Неизвестный параметр: " << arg << endl;
+            valid = false;
+        } else if (i + 1 >= argc) {
+            cerr << "Не указано значение параметра " << arg << endl;
+            valid = false;
+        } else if (!handler->second(argv[++i])) {
+            cerr << "Неверное значение параметра " << arg << ": " << argv[i] << endl;
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+const char* const bench_usage =
+    "Использование: zad1 --bench [--threads N,...] [--cs N,...] [--iters N] [--only имя,...]\n"
+    "                            [--csv файл] [--json файл]\n";
+
+BenchOptions parse_bench_options(int argc, char* argv[]) {
+    BenchOptions options;
+    options.valid = parse_option_list(argc, argv, {
+        {"--threads", [&](const string& v) { return parse_int_list(v, options.thread_counts, 1); }},
+        {"--cs", [&](const string& v) { return parse_int_list(v, options.cs_lengths, 0); }},
+        {"--iters", [&](const string& v) { return parse_number(v, options.iterations, 1L); }},
+        {"--only", [&](const string& v) { options.only = parse_name_list(v); return true; }},
+        {"--csv", [&](const string& v) { options.csv_file = v; return true; }},
+        {"--json", [&](const string& v) { options.json_file = v; return true; }},
+    });
+    if (options.thread_counts.empty()) {
+        // По умолчанию 1, 2, 4, ... до удвоенного числа ядер
+        int limit = 2 * max(1, static_cast<int>(thread::hardware_concurrency()));
+        for (int n = 1; n <= limit; n *= 2) {
+            options.thread_counts.push_back(n);
+        }
+    }
+    return options;
+}
+
+// Заголовок таблицы: ширина столбцов в символах, как в printf (отрицательная — выравнивание
+// влево). printf считает байты, а кириллица в UTF-8 занимает по два байта на букву
+void print_table_header(initializer_list<pair<const char*, int>> columns) {
+    string line;
+    for (const auto& [title, width] : columns) {
+        size_t length = 0;
+        for (const char* c = title; *c; ++c) {
+            length += (static_cast<unsigned char>(*c) & 0xC0) != 0x80; // байты продолжения не считаются
+        }
+        string padding(static_cast<size_t>(abs(width)) > length ? abs(width) - length : 0, ' ');
+        if (!line.empty()) {
+            line += ' ';
+        }
+        line += width < 0 ? title + padding : padding + title;
+    }
+    printf("%s\n", line.c_str());
+}
+
+void run_benchmarks(const BenchOptions& options) {
+    vector<BenchResult> results;
+    print_table_header({{"примитив", -17}, {"потоки", 7}, {"cs", 6}, {"время, с", 12}, {"захватов/с", 14},
+                        {"p50, нс", 9}, {"p99, нс", 9}, {"p999, нс", 9}, {"max, нс", 10}});
+    for (const auto& [name, bench] : bench_primitives()) {
+        if (!options.only.empty() && find(options.only.begin(), options.only.end(), name) == options.only.end()) {
+            continue;
+        }
+        for (int cs : options.cs_lengths) {
+            for (int threads : options.thread_counts) {
+                BenchResult r = bench(name, threads, cs, options.iterations);
+                printf("%-17s %7d %6d %12.4f %14.0f %9llu %9llu %9llu %10llu%s\n", r.primitive.c_str(), r.threads, r.cs_length, r.seconds, r.ops_per_sec,
+                       static_cast<unsigned long long>(r.p50_ns), static_cast<unsigned long long>(r.p99_ns),
+                       static_cast<unsigned long long>(r.p999_ns), static_cast<unsigned long long>(r.max_ns),
+                       r.correct ? "" : "  ОШИБКА: нарушено взаимное исключение");
+                fflush(stdout);
+                results.push_back(r);
+            }
+        }
+    }
+    if (!options.csv_file.empty()) {
+        write_csv(options.csv_file, results);
+    }
+    if (!options.json_file.empty()) {
+        write_json(options.json_file, results);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Очереди для передачи сообщений между потоками: ограниченные lock-free очереди
+// (MPMC по схеме Вьюкова и SPSC) и очереди на существующих примитивах.
+// Нагрузочное тестирование производителей и потребителей: ./zad1 --queue-bench [параметры]
+// ---------------------------------------------------------------------------
+
+// Ограниченная очередь для многих производителей и многих потребителей (Д. Вьюков).
+// У каждой ячейки свой счётчик последовательности: производитель ждёт в ячейке значения
+// своей позиции, потребитель — позиции + 1. Позиции записи и чтения разнесены по разным
+// кеш-линии, ячейки тоже, поэтому производители и потребители не мешают друг другу
+template <typename T>
+class MPMCQueue {
+public:
+    // Ёмкость округляется вверх до степени двойки
+    explicit MPMCQueue(size_t capacity) : mask(round_up(capacity) - 1), cells(new Cell[mask + 1]) {
+        for (size_t i = 0; i <= mask; ++i) {
+            cells[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
+
+    bool try_push(const T& value) {
+        size_t pos = enqueue_pos.load(memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                // Ячейка свободна: занимаем позицию, если её не забрал другой производитель
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    cell.data = value;
+                    cell.sequence.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // очередь заполнена
+            } else {
+                pos = enqueue_pos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& value) {
+        size_t pos = dequeue_pos.load(memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    value = cell.data;
+                    cell.sequence.store(pos + mask + 1, memory_order_release); // ячейка свободна для следующего круга
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // очередь пуста
+            } else {
+                pos = dequeue_pos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct alignas(cache_line) Cell {
+        atomic<size_t> sequence;
+        T data;
+    };
+
+    static size_t round_up(size_t n) {
+        size_t size = 2;
+        while (size < n) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    const size_t mask;
+    unique_ptr<Cell[]> cells;
+    alignas(cache_line) atomic<size_t> enqueue_pos{0}; // Следующая позиция записи
+    alignas(cache_line) atomic<size_t> dequeue_pos{0}; // Следующая позиция чтения
+    char padding[cache_line - sizeof(atomic<size_t>)];
+};
+
+// Ограниченная очередь для одного производителя и одного потребителя: без атомарных
+// read-modify-write, только загрузки и записи. Каждая сторона хранит копию чужой позиции
+// и перечитывает её, только когда копия говорит, что очередь полна (пуста)
+template <typename T>
+class SPSCQueue {
+public:
+    explicit SPSCQueue(size_t capacity) : size(max<size_t>(capacity, 1) + 1), slots(new T[size]) {}
+
+    bool try_push(const T& value) {
+        size_t tail = write_pos.load(memory_order_relaxed);
+        size_t next = tail + 1 == size ? 0 : tail + 1;
+        if (next == cached_read) {
+            cached_read = read_pos.load(memory_order_acquire);
+            if (next == cached_read) {
+                return false; // очередь заполнена
+            }
+        }
+        slots[tail] = value;
+        write_pos.store(next, memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        size_t head = read_pos.load(memory_order_relaxed);
+        if (head == cached_write) {
+            cached_write = write_pos.load(memory_order_acquire);
+            if (head == cached_write) {
+                return false; // очередь пуста
+            }
+        }
+        value = slots[head];
+        read_pos.store(head + 1 == size ? 0 : head + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    const size_t size; // Одна ячейка всегда пуста, чтобы отличать полную очередь от пустой
+    unique_ptr<T[]> slots;
+    alignas(cache_line) atomic<size_t> write_pos{0}; // Меняет только производитель
+    size_t cached_read = 0;                          // Копия read_pos у производителя
+    alignas(cache_line) atomic<size_t> read_pos{0};  // Меняет только потребитель
+    size_t cached_write = 0;                         // Копия write_pos у потребителя
+    char padding[cache_line - sizeof(atomic<size_t>) - sizeof(size_t)];
+};
+
+// Блокирующие push/pop для lock-free очередей: ожидание в цикле с SpinBackoff
+template <typename Queue, typename T>
+struct SpinningQueue {
+    Queue queue;
+
+    explicit SpinningQueue(size_t capacity) : queue(capacity) {}
+
+    void push(const T& value) {
+        SpinBackoff backoff;
+        while (!queue.try_push(value)) {
+            backoff.pause();
+        }
+    }
+
+    void pop(T& value) {
+        SpinBackoff backoff;
+        while (!queue.try_pop(value)) {
+            backoff.pause();
+        }
+    }
+};
+
+// Кольцевой буфер без синхронизации: основа очередей на примитивах
+template <typename T>
+class Ring {
+public:
+    explicit Ring(size_t capacity) : slots(max<size_t>(capacity, 1)) {}
+
+    bool full() const { return count == slots.size(); }
+    bool empty() const { return count == 0; }
+
+    void push(const T& value) {
+        slots[(head + count) % slots.size()] = value;
+        ++count;
+    }
+
+    T pop() {
+        T value = slots[head];
+        head = (head + 1) % slots.size();
+        --count;
+        return value;
+    }
+
+private:
+    vector<T> slots;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+// Классическая очередь: мьютекс и две условные переменные (есть место / есть сообщения)
+template <typename T>
+class MutexCvQueue {
+public:
+    explicit MutexCvQueue(size_t capacity) : ring(capacity) {}
+
+    void push(const T& value) {
+        unique_lock<mutex> lock(m);
+        not_full.wait(lock, [this]() { return !ring.full(); });
+        ring.push(value);
+        lock.unlock();
+        not_empty.notify_one();
+    }
+
+    void pop(T& value) {
+        unique_lock<mutex> lock(m);
+        not_empty.wait(lock, [this]() { return !ring.empty(); });
+        value = ring.pop();
+        lock.unlock();
+        not_full.notify_one();
+    }
+
+private:
+    Ring<T> ring;
+    mutex m;
+    condition_variable not_full;
+    condition_variable not_empty;
+};
+
+// Очередь под Monitor: у монитора нет условий ожидания, поэтому при полной (пустой)
+// очереди поток выходит из монитора и повторяет попытку после паузы
+template <typename T>
+class MonitorQueue {
+public:
+    explicit MonitorQueue(size_t capacity) : ring(capacity) {}
+
+    void push(const T& value) {
+        SpinBackoff backoff;
+        while (true) {
+            monitor.enter();
+            if (!ring.full()) {
+                ring.push(value);
+                monitor.exit();
+                return;
+            }
+            monitor.exit();
+            backoff.pause();
+        }
+    }
+
+    void pop(T& value) {
+        SpinBackoff backoff;
+        while (true) {
+            monitor.enter();
+            if (!ring.empty()) {
+                value = ring.pop();
+                monitor.exit();
+                return;
+            }
+            monitor.exit();
+            backoff.pause();
+        }
+    }
+
+private:
+    Ring<T> ring;
+    Monitor monitor;
+};
+
+// Очередь на семафорах (задача о кольцевом буфере): свободные ячейки и сообщения считают
+// два SemaphoreSlim, доступ к буферу защищает третий со счётчиком 1
+template <typename T>
+class SemaphoreSlimQueue {
+public:
+    explicit SemaphoreSlimQueue(size_t capacity)
+        : ring(capacity), free_slots(static_cast<int>(max<size_t>(capacity, 1))), items(0), access(1) {}
+
+    void push(const T& value) {
+        free_slots.wait();
+        access.wait();
+        ring.push(value);
+        access.release();
+        items.release();
+    }
+
+    void pop(T& value) {
+        items.wait();
+        access.wait();
+        value = ring.pop();
+        access.release();
+        free_slots.release();
+    }
+
+private:
+    Ring<T> ring;
+    SemaphoreSlim free_slots;
+    SemaphoreSlim items;
+    SemaphoreSlim access;
+};
+
+// Сообщение: время отправки для задержки от производителя до потребителя и полезная нагрузка
+struct Message {
+    int64_t sent_ns = 0;
+    int64_t value = 0; // Отрицательное значение — сигнал потребителю завершиться
+};
+
+inline int64_t now_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Параметры нагрузочного тестирования очередей
+struct QueueBenchOptions {
+    vector<int> producer_counts = {1, 2, 4};
+    vector<int> consumer_counts = {1, 2, 4};
+    long messages = 1000000; // Сообщений от каждого производителя
+    size_t capacity = 1024;  // Ёмкость очереди
+    vector<string> only;     // Тестировать только эти очереди (пусто — все)
+    string csv_file;         // Куда сохранить результаты в CSV
+    bool valid = true;       // Ложь, если в командной строке есть ошибка
+};
+
+// Результат одного прогона очереди
+struct QueueBenchResult {
+    string queue;
+    int producers = 0;
+    int consumers = 0;
+    long messages = 0;       // Сообщений от каждого производителя
+    double seconds = 0;
+    double msgs_per_sec = 0; // Доставленных сообщений в секунду
+    uint64_t p50_ns = 0;     // Задержка от отправки до получения
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    uint64_t max_ns = 0;
+    bool correct = true;     // Каждое сообщение получено ровно один раз
+};
+
+// Прогон: производители отправляют messages сообщений каждый, последний закончивший
+// отправляет по одному сигналу завершения на потребителя. Потребители записывают задержку
+// каждого сообщения и сумму значений, по которой проверяется, что ничего не потеряно и не повторено
+template <typename Queue>
+QueueBenchResult bench_queue(const string& name, int producers, int consumers, long messages, size_t capacity) {
+    Queue queue(capacity);
+    atomic<int> producers_left{producers};
+    atomic<long long> received_sum{0};
+    atomic<long long> received_count{0};
+    LatencyHistogram histogram;
+    double seconds = run_threads(producers + consumers, [&](int index, LatencyHistogram& h) {
+        if (index < producers) {
+            for (long i = 0; i < messages; ++i) {
+                queue.push(Message{now_ns(), i});
+            }
+            if (producers_left.fetch_sub(1) == 1) {
+                for (int c = 0; c < consumers; ++c) {
+                    queue.push(Message{0, -1});
+                }
+            }
+            return;
+        }
+        long long sum = 0;
+        long long count = 0;
+        Message message;
+        while (true) {
+            queue.pop(message);
+            if (message.value < 0) {
+                break;
+            }
+            h.record(static_cast<uint64_t>(now_ns() - message.sent_ns));
+            sum += message.value;
+            ++count;
+        }
+        received_sum.fetch_add(sum);
+        received_count.fetch_add(count);
+    }, histogram);
+
+    QueueBenchResult result;
+    result.queue = name;
+    result.producers = producers;
+    result.consumers = consumers;
+    result.messages = messages;
+    result.seconds = seconds;
+    result.msgs_per_sec = seconds > 0 ? producers * static_cast<double>(messages) / seconds : 0;
+    result.p50_ns = histogram.percentile(0.5);
+    result.p99_ns = histogram.percentile(0.99);
+    result.p999_ns = histogram.percentile(0.999);
+    result.max_ns = histogram.max_ns();
+    result.correct = received_count.load() == producers * static_cast<long long>(messages) &&
+                     received_sum.load() == producers * (static_cast<long long>(messages) * (messages - 1) / 2);
+    return result;
+}
+
+// Список тестируемых очередей: название, прогон и подходит ли очередь для нескольких
+// производителей и потребителей
+struct QueueKind {
+    string name;
+    function<QueueBenchResult(const string&, int, int, long, size_t)> bench;
+    bool multi;
+};
+
+vector<QueueKind> bench_queues() {
+    return {
+        {"mpmc", bench_queue<SpinningQueue<MPMCQueue<Message>, Message>>, true},
+        {"spsc", bench_queue<SpinningQueue<SPSCQueue<Message>, Message>>, false},
+        {"mutex_cv", bench_queue<MutexCvQueue<Message>>, true},
+        {"monitor", bench_queue<MonitorQueue<Message>>, true},
+        {"semaphore_slim", bench_queue<SemaphoreSlimQueue<Message>>, true},
+    };
+}
+
+const char* const queue_bench_usage =
+    "Использование: zad1 --queue-bench [--producers N,...] [--consumers N,...] [--messages N]\n"
+    "                                  [--capacity N] [--only имя,...] [--csv файл]\n";
+
+QueueBenchOptions parse_queue_bench_options(int argc, char* argv[]) {
+    QueueBenchOptions options;
+    options.valid = parse_option_list(argc, argv, {
+        {"--producers", [&](const string& v) { return parse_int_list(v, options.producer_counts, 1); }},
+        {"--consumers", [&](const string& v) { return parse_int_list(v, options.consumer_counts, 1); }},
+        {"--messages", [&](const string& v) { return parse_number(v, options.messages, 1L); }},
+        {"--capacity", [&](const string& v) { return parse_number(v, options.capacity, size_t{1}); }},
+        {"--only", [&](const string& v) { options.only = parse_name_list(v); return true; }},
+        {"--csv", [&](const string& v) { options.csv_file = v; return true; }},
+    });
+    return options;
+}
+
+void run_queue_benchmarks(const QueueBenchOptions& options) {
+    vector<QueueBenchResult> results;
+    print_table_header({{"очередь", -16}, {"произв", 6}, {"потреб", 6}, {"время, с", 12}, {"сообщений/с", 14},
+                        {"p50, нс", 9}, {"p99, нс", 9}, {"p999, нс", 9}, {"max, нс", 10}});
+    for (const auto& kind : bench_queues()) {
+        if (!options.only.empty() && find(options.only.begin(), options.only.end(), kind.name) == options.only.end()) {
+            continue;
+        }
+        for (int producers : options.producer_counts) {
+            for (int consumers : options.consumer_counts) {
+                if (producers < 1 || consumers < 1 || (!kind.multi && (producers > 1 || consumers > 1))) {
+                    continue; // SPSC — только один производитель и один потребитель
+                }
+                QueueBenchResult r = kind.bench(kind.name, producers, consumers, options.messages, options.capacity);
+                printf("%-16s %6d %6d %12.4f %14.0f %9llu %9llu %9llu %10llu%s\n", r.queue.c_str(), r.producers, r.consumers, r.seconds, r.msgs_per_sec,
+                       static_cast<unsigned long long>(r.p50_ns), static_cast<unsigned long long>(r.p99_ns),
+                       static_cast<unsigned long long>(r.p999_ns), static_cast<unsigned long long>(r.max_ns),
+                       r.correct ? "" : "  ОШИБКА: сообщения потеряны или повторены");
+                fflush(stdout);
+                results.push_back(r);
+            }
+        }
+    }
+    if (!options.csv_file.empty()) {
+        ofstream out(options.csv_file);
+        out << "queue,producers,consumers,messages,seconds,msgs_per_sec,p50_ns,p99_ns,p999_ns,max_ns,correct\n";
+        for (const auto& r : results) {
+            out << r.queue << ',' << r.producers << ',' << r.consumers << ',' << r.messages << ',' << r.seconds << ','
+                << r.msgs_per_sec << ',' << r.p50_ns << ',' << r.p99_ns << ',' << r.p999_ns << ',' << r.max_ns << ','
+                << (r.correct ? "true" : "false") << '\n';
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Те же примитивы на сопрограммах: акторы (клиенты примитива) выполняются на нескольких
+// рабочих потоках, а не по потоку ОС на каждого. Сравнение с потоком на актор по
+// пропускной способности, переключениям контекста и памяти на актора.
+// Запуск: ./zad1 --coro-bench [--actors N] [--workers N] [--iters N] [--thread-actors N]
+// ---------------------------------------------------------------------------
+
+struct CoroBenchOptions {
+    long actors = 100000;        // Акторов-сопрограмм
+    long thread_actors = 1000;   // Потоков в варианте «поток на актора» (не больше actors)
+    int workers = max(1, static_cast<int>(thread::hardware_concurrency())); // Рабочих потоков планировщика
+    long iterations = 10;        // Захватов на актора
+    string csv_file;
+    bool valid = true;           // Ложь, если в командной строке есть ошибка
+};
+
+struct CoroBenchResult {
+    string primitive;
+    string mode;             // "threads" или "coroutines"
+    long actors = 0;
+    double seconds = 0;
+    double ops_per_sec = 0;  // Захватов (проходов барьера) в секунду
+    double switches_per_sec = 0; // Переключений контекста в секунду
+    double bytes_per_actor = 0;  // Память на актора: стек потока или кадр сопрограммы
+};
+
+// Поток на актора: все потоки создаются и ждут общего сигнала, память замеряется, пока
+// живы все; переключения — по счётчикам ОС за время прогона
+CoroBenchResult bench_threads(const string& name, long actors, const function<void()>& body) {
+    long long rss_before = coro::resident_bytes();
+    atomic<long> ready{0};
+    atomic<bool> go{false};
+    vector<thread> threads;
+    threads.reserve(actors);
+    for (long i = 0; i < actors; ++i) {
+        threads.emplace_back([&]() {
+            ready.fetch_add(1);
+            while (!go.load(memory_order_acquire)) {
+                this_thread::yield();
+            }
+            body();
+        });
+    }
+    while (ready.load() != actors) {
+        this_thread::yield();
+    }
+    long long rss_peak = coro::resident_bytes();
+    long long switches_before = coro::os_context_switches();
+    auto start = chrono::steady_clock::now();
+    go.store(true, memory_order_release);
+    for (auto& t : threads) {
+        t.join();
+    }
+    chrono::duration<double> duration = chrono::steady_clock::now() - start;
+
+    CoroBenchResult result;
+    result.primitive = name;
+    result.mode = "threads";
+    result.actors = actors;
+    result.seconds = duration.count();
+    result.switches_per_sec = (coro::os_context_switches() - switches_before) / result.seconds;
+    result.bytes_per_actor = static_cast<double>(rss_peak - rss_before) / actors;
+    return result;
+}
+
+// Сопрограмма на актора: кадры создаются до запуска, память на актора — размер кадра
+// (резидентная память здесь неточна: кадры занимают память, освобождённую прошлыми
+// прогонами); переключения — запуски сопрограмм планировщиком плюс переключения его потоков
+template <typename MakeActor>
+CoroBenchResult bench_coroutines(const string& name, long actors, int workers, MakeActor&& make_actor) {
+    coro::Scheduler scheduler(workers);
+    long long frames_before = coro::frame_bytes.load();
+    vector<coro::Actor> pending;
+    pending.reserve(actors);
+    for (long i = 0; i < actors; ++i) {
+        pending.push_back(make_actor());
+    }
+    long long frames_peak = coro::frame_bytes.load();
+    long long switches_before = coro::os_context_switches();
+    uint64_t resumes_before = scheduler.switches();
+    auto start = chrono::steady_clock::now();
+    for (auto& actor : pending) {
+        scheduler.spawn(move(actor));
+    }
+    scheduler.wait_all();
+    chrono::duration<double> duration = chrono::steady_clock::now() - start;
+
+    CoroBenchResult result;
+    result.primitive = name;
+    result.mode = "coroutines";
+    result.actors = actors;
+    result.seconds = duration.count();
+    result.switches_per_sec = (scheduler.switches() - resumes_before + coro::os_context_switches() - switches_before) / result.seconds;
+    result.bytes_per_actor = static_cast<double>(frames_peak - frames_before) / actors;
+    return result;
+}
+
+// Акторы-сопрограммы для каждого примитива: iterations захватов с работой в критической секции
+coro::Actor coro_lock_client(coro::AsyncMutex& m, long iterations, long& counter) {
+    for (long i = 0; i < iterations; ++i) {
+        co_await m.lock();
+        ++counter;
+        critical_work(100);
+        m.unlock();
+    }
+}
+
+coro::Actor coro_semaphore_client(coro::AsyncSemaphore& sem, long iterations) {
+    for (long i = 0; i < iterations; ++i) {
+        co_await sem.acquire();
+        critical_work(100);
+        sem.release();
+    }
+}
+
+coro::Actor coro_barrier_client(coro::AsyncBarrier& bar, long iterations) {
+    for (long i = 0; i < iterations; ++i) {
+        critical_work(100);
+        co_await bar.arrive_and_wait();
+    }
+}
+
+coro::Actor coro_monitor_client(coro::AsyncMonitor& monitor, long iterations, long& counter) {
+    for (long i = 0; i < iterations; ++i) {
+        co_await monitor.enter();
+        ++counter;
+        critical_work(100);
+        monitor.exit();
+    }
+}
+
+coro::Actor coro_semaphore_slim_client(coro::AsyncSemaphoreSlim& sem, long iterations, long& counter) {
+    for (long i = 0; i < iterations; ++i) {
+        co_await sem.wait();
+        ++counter;
+        critical_work(100);
+        sem.release();
+    }
+}
+
+void run_coro_benchmarks(const CoroBenchOptions& options) {
+    long n = options.actors;
+    long t = min(options.thread_actors, options.actors);
+    long iters = options.iterations;
+    vector<CoroBenchResult> results;
+
+    auto add = [&](CoroBenchResult r, long actors) {
+        r.ops_per_sec = r.seconds > 0 ? actors * static_cast<double>(iters) / r.seconds : 0;
+        printf("%-16s %-11s %9ld %10.4f %14.0f %16.0f %14.0f\n", r.primitive.c_str(), r.mode.c_str(), r.actors, r.seconds,
+               r.ops_per_sec, r.switches_per_sec, r.bytes_per_actor);
+        fflush(stdout);
+        results.push_back(r);
+    };
+
+    print_table_header({{"примитив", -16}, {"режим", -11}, {"акторы", 9}, {"время, с", 10}, {"захватов/с", 14},
+                        {"переключений/с", 16}, {"байт/актор", 14}});
+    {
+        mutex m;
+        long counter = 0;
+        add(bench_threads("mutex", t, [&]() {
+            for (long i = 0; i < iters; ++i) {
+                lock_guard<mutex> lock(m);
+                ++counter;
+                critical_work(100);
+            }
+        }), t);
+        coro::AsyncMutex am;
+        long coro_counter = 0;
+        add(bench_coroutines("mutex", n, options.workers, [&]() { return coro_lock_client(am, iters, coro_counter); }), n);
+        if (counter != t * iters || coro_counter != n * iters) {
+            printf("ОШИБКА: нарушено взаимное исключение\n");
+        }
+    }
+    {
+        counting_semaphore<3> sem(3);
+        add(bench_threads("semaphore", t, [&]() {
+            for (long i = 0; i < iters; ++i) {
+                sem.acquire();
+                critical_work(100);
+                sem.release();
+            }
+        }), t);
+        coro::AsyncSemaphore asem(3);
+        add(bench_coroutines("semaphore", n, options.workers, [&]() { return coro_semaphore_client(asem, iters); }), n);
+    }
+    {
+        barrier bar(t);
+        add(bench_threads("barrier", t, [&]() {
+            for (long i = 0; i < iters; ++i) {
+                critical_work(100);
+                bar.arrive_and_wait();
+            }
+        }), t);
+        coro::AsyncBarrier abar(n);
+        add(bench_coroutines("barrier", n, options.workers, [&]() { return coro_barrier_client(abar, iters); }), n);
+    }
+    {
+        Monitor monitor;
+        long counter = 0;
+        add(bench_threads("monitor", t, [&]() {
+            for (long i = 0; i < iters; ++i) {
+                monitor.enter();
+                ++counter;
+                critical_work(100);
+                monitor.exit();
+            }
+        }), t);
+        coro::AsyncMonitor amonitor;
+        long coro_counter = 0;
+        add(bench_coroutines("monitor", n, options.workers, [&]() { return coro_monitor_client(amonitor, iters, coro_counter); }), n);
+        if (counter != t * iters || coro_counter != n * iters) {
+            printf("ОШИБКА: нарушено взаимное исключение\n");
+        }
+    }
+    {
+        SemaphoreSlim sem(1);
+        long counter = 0;
+        add(bench_threads("semaphore_slim", t, [&]() {
+            for (long i = 0; i < iters; ++i) {
+                sem.wait();
+                ++counter;
+                critical_work(100);
+                sem.release();
+            }
+        }), t);
+        coro::AsyncSemaphoreSlim asem(1);
+        long coro_counter = 0;
+        add(bench_coroutines("semaphore_slim", n, options.workers, [&]() { return coro_semaphore_slim_client(asem, iters, coro_counter); }), n);
+        if (counter != t * iters || coro_counter != n * iters) {
+            printf("ОШИБКА: нарушено взаимное исключение\n");
+        }
+    }
+
+    if (!options.csv_file.empty()) {
+        ofstream out(options.csv_file);
+        out << "primitive,mode,actors,seconds,ops_per_sec,switches_per_sec,bytes_per_actor\n";
+        for (const auto& r : results) {
+            out << r.primitive << ',' << r.mode << ',' << r.actors << ',' << r.seconds << ',' << r.ops_per_sec << ','
+                << r.switches_per_sec << ',' << r.bytes_per_actor << '\n';
+        }
+    }
+}
+
+const char* const coro_bench_usage =
+    "Использование: zad1 --coro-bench [--actors N] [--thread-actors N] [--workers N] [--iters N]\n"
+    "                                 [--csv файл]\n";
+
+CoroBenchOptions parse_coro_bench_options(int argc, char* argv[]) {
+    CoroBenchOptions options;
+    options.valid = parse_option_list(argc, argv, {
+        {"--actors", [&](const string& v) { return parse_number(v, options.actors, 1L); }},
+        {"--thread-actors", [&](const string& v) { return parse_number(v, options.thread_actors, 1L); }},
+        {"--workers", [&](const string& v) { return parse_number(v, options.workers, 1); }},
+        {"--iters", [&](const string& v) { return parse_number(v, options.iterations, 1L); }},
+        {"--csv", [&](const string& v) { options.csv_file = v; return true; }},
+    });
+    return options;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        BenchOptions options = parse_bench_options(argc, argv);
+        if (!options.valid) {
+            cerr << bench_usage;
+            return 1;
+        }
+        run_benchmarks(options);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--queue-bench") {
+        QueueBenchOptions options = parse_queue_bench_options(argc, argv);
+        if (!options.valid) {
+            cerr << queue_bench_usage;
+            return 1;
+        }
+        run_queue_benchmarks(options);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--coro-bench") {
+        CoroBenchOptions options = parse_coro_bench_options(argc, argv);
+        if (!options.valid) {
+            cerr << coro_bench_usage;
+            return 1;
+        }
+        run_coro_benchmarks(options);
+        return 0;
+    }
 
-int main() {
     //cout << "Запуск потоков, генерирующих случайные символы:" << endl;
 
     const int num_threads = 8; // количество потоков
@@ -314,6 +1779,9 @@ int main() {
     test_spinwait(num_threads);
     test_monitor(num_threads);
     test_semaphore_slim(num_threads);
+    test_lock<TTASLock>("TTASLock", num_threads);
+    test_lock<TicketLock>("TicketLock", num_threads);
+    test_lock<MCSLock>("MCSLock", num_threads);
 
     return 0;
 }
\ No newline at end of file
@@ -3,178 +3,4268 @@
 #include <thread>
 #include <chrono>
 #include <unordered_map>
+#include <map>
 #include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <deque>
+#include <queue>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <span>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <charconv>
+#include <utility>
+#include <climits>
+#include <cmath>
+#include <tuple>
+#include <cstdio>
 #include <fstream>
-#include <sstream>
+#include <new>
+#include <memory_resource>
+#include <numeric>
+#include <bit>
+#include <random>
+#include <sys/uio.h>
+#include <glob.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-// Структура, описывающая товар
-struct Product {
-    std::string name; // Название товара
-    double price;     // Цена товара
-    int quantity;     // Количество товара
+// Счётчики выделений памяти в куче (operator new заменён ниже): позволяют проверить,
+// сколько обращений к общему распределителю делает каждый этап
+struct AllocationStats {
+    uint64_t count = 0; // Число выделений
+    uint64_t bytes = 0; // Запрошено байт
+
+    static AllocationStats now();
+
+    AllocationStats since(const AllocationStats& before) const {
+        return {count - before.count, bytes - before.bytes};
+    }
+};
+
+std::atomic<uint64_t> allocationCount{0};
+std::atomic<uint64_t> allocationBytes{0};
+
+AllocationStats AllocationStats::now() {
+    return {allocationCount.load(std::memory_order_relaxed), allocationBytes.load(std::memory_order_relaxed)};
+}
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// noinline: иначе GCC, встроив free в место вызова delete, предупреждает о несоответствии new/free
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+// Аппаратные счётчики текущего потока через perf_event_open: такты, инструкции, промахи
+// кеша и ошибки предсказания переходов. Счётчики открываются одной группой, чтобы читать
+// их одним вызовом. Если ядро не разрешает (perf_event_paranoid, контейнер), open() вернёт false
+class PerfCounters {
+public:
+    static constexpr int count = 4;
+    static constexpr const char* names[count] = {"такты", "инструкции", "промахи кеша", "ошибки переходов"};
+
+    PerfCounters() = default;
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+
+    bool open() {
+        static const uint64_t configs[count] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int i = 0; i < count; ++i) {
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.exclude_kernel = 1; // без прав доступны только счётчики пользовательского режима
+            attr.exclude_hv = 1;
+            fds[i] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0));
+            if (fds[i] < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool read(uint64_t values[count]) const {
+        uint64_t buffer[1 + count];
+        if (fds[0] < 0 || ::read(fds[0], buffer, sizeof(buffer)) != static_cast<ssize_t>(sizeof(buffer))) {
+            return false;
+        }
+        std::copy(buffer + 1, buffer + 1 + count, values); // buffer[0] — число счётчиков в группе
+        return true;
+    }
+
+private:
+    int fds[count] = {-1, -1, -1, -1};
+};
+
+// Один замер этапа
+struct PhaseEvent {
+    const char* name;
+    int thread;           // Номер потока в профилировщике (0 — поток, первым сделавший замер)
+    int64_t startNs;      // От запуска профилировщика
+    int64_t durationNs;
+    bool hasCounters;
+    uint64_t counters[PerfCounters::count];
+};
+
+// Профилировщик этапов конвейера. Замеры пишутся в журнал своего потока без блокировок;
+// журналы принадлежат профилировщику и переживают завершение потоков. Пока профилировщик
+// выключен, ScopedPhase стоит одной проверки флага
+class Profiler {
+public:
+    void enable(bool withCounters) {
+        origin = std::chrono::steady_clock::now();
+        counters = withCounters;
+        on.store(true, std::memory_order_release);
+    }
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    // Журнал и счётчики текущего потока (создаются при первом замере в потоке)
+    struct ThreadLog {
+        int index;
+        bool countersOpen = false;
+        PerfCounters perf;
+        std::vector<PhaseEvent> events;
+    };
+
+    ThreadLog& threadLog() {
+        thread_local ThreadLog* log = nullptr;
+        if (!log) {
+            std::lock_guard<std::mutex> lock(mtx);
+            logs.push_back(std::make_unique<ThreadLog>());
+            log = logs.back().get();
+            log->index = static_cast<int>(logs.size()) - 1;
+            if (counters) {
+                log->countersOpen = log->perf.open();
+                countersFailed = countersFailed || !log->countersOpen;
+            }
+        }
+        return *log;
+    }
+
+    // Сводная таблица по этапам: число замеров, суммарное и «настенное» время, потоки,
+    // дисбаланс нагрузки (самый загруженный поток к среднему) и аппаратные счётчики
+    void printSummary(std::ostream& out) const {
+        struct Phase {
+            const char* name = nullptr;
+            size_t calls = 0;
+            int64_t totalNs = 0;
+            int64_t firstStart = INT64_MAX;
+            int64_t lastEnd = 0;
+            std::vector<int64_t> perThread;
+            bool hasCounters = false;
+            uint64_t counters[PerfCounters::count] = {};
+        };
+        std::vector<Phase> phases;
+        for (const auto& log : logs) {
+            for (const PhaseEvent& e : log->events) {
+                auto it = std::find_if(phases.begin(), phases.end(), [&](const Phase& p) { return std::strcmp(p.name, e.name) == 0; });
+                if (it == phases.end()) {
+                    phases.emplace_back();
+                    phases.back().name = e.name;
+                    it = phases.end() - 1;
+                }
+                ++it->calls;
+                it->totalNs += e.durationNs;
+                it->firstStart = std::min(it->firstStart, e.startNs);
+                it->lastEnd = std::max(it->lastEnd, e.startNs + e.durationNs);
+                if (it->perThread.size() <= static_cast<size_t>(e.thread)) {
+                    it->perThread.resize(e.thread + 1);
+                }
+                it->perThread[e.thread] += e.durationNs;
+                if (e.hasCounters) {
+                    it->hasCounters = true;
+                    for (int i = 0; i < PerfCounters::count; ++i) {
+                        it->counters[i] += e.counters[i];
+                    }
+                }
+            }
+        }
+        std::sort(phases.begin(), phases.end(), [](const Phase& a, const Phase& b) { return a.firstStart < b.firstStart; });
+
+        out << "\nПрофиль этапов (время в мс):\n";
+        out << padRight("этап", 26) << padLeft("замеров", 9) << padLeft("сумма", 10) << padLeft("от-до", 10)
+            << padLeft("потоков", 9) << padLeft("дисбаланс", 11);
+        if (counters) {
+            out << padLeft("IPC", 7) << padLeft("промахи/1000", 14) << padLeft("переходы/1000", 15);
+        }
+        out << "\n";
+        for (const Phase& p : phases) {
+            int threads = 0;
+            int64_t busiest = 0;
+            for (int64_t ns : p.perThread) {
+                threads += ns > 0;
+                busiest = std::max(busiest, ns);
+            }
+            double mean = threads > 0 ? static_cast<double>(p.totalNs) / threads : 0;
+            out << padRight(p.name, 26) << padLeft(std::to_string(p.calls), 9) << padLeft(milliseconds(p.totalNs), 10)
+                << padLeft(milliseconds(p.lastEnd - p.firstStart), 10) << padLeft(std::to_string(threads), 9)
+                << padLeft(mean > 0 ? fixed(busiest / mean, 2) : "-", 11);
+            if (counters) {
+                if (p.hasCounters && p.counters[0] > 0 && p.counters[1] > 0) {
+                    double perThousand = 1000.0 / p.counters[1];
+                    out << padLeft(fixed(static_cast<double>(p.counters[1]) / p.counters[0], 2), 7)
+                        << padLeft(fixed(p.counters[2] * perThousand, 2), 14) << padLeft(fixed(p.counters[3] * perThousand, 2), 15);
+                } else {
+                    out << padLeft("-", 7) << padLeft("-", 14) << padLeft("-", 15);
+                }
+            }
+            out << "\n";
+        }
+        if (counters && countersFailed) {
+            out << "Аппаратные счётчики недоступны (perf_event_open запрещён ядром) — показано только время\n";
+        }
+    }
+
+    // Экспорт в формате Chrome Trace Event (chrome://tracing, Perfetto): каждый замер —
+    // событие "X" с началом и длительностью в микросекундах, счётчики — в args
+    bool writeTrace(const std::string& filename) const {
+        std::ofstream out(filename);
+        if (!out) {
+            std::cerr << "Не удалось создать файл: " << filename << "\n";
+            return false;
+        }
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (const auto& log : logs) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << log->index
+                << ",\"args\":{\"name\":\"поток " << log->index << "\"}}";
+            first = false;
+            for (const PhaseEvent& e : log->events) {
+                out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+                    << ",\"ts\":" << fixed(e.startNs / 1000.0, 3) << ",\"dur\":" << fixed(e.durationNs / 1000.0, 3);
+                if (e.hasCounters) {
+                    out << ",\"args\":{\"cycles\":" << e.counters[0] << ",\"instructions\":" << e.counters[1]
+                        << ",\"cache_misses\":" << e.counters[2] << ",\"branch_misses\":" << e.counters[3] << "}";
+                }
+                out << "}";
+            }
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+
+private:
+    // Ширина столбцов считается в символах, а не в байтах (названия этапов — UTF-8)
+    static size_t displayWidth(const std::string& text) {
+        return std::count_if(text.begin(), text.end(), [](char c) { return (static_cast<unsigned char>(c) & 0xC0) != 0x80; });
+    }
+    static std::string padRight(const std::string& text, size_t width) {
+        return text + std::string(width > displayWidth(text) ? width - displayWidth(text) : 1, ' ');
+    }
+    static std::string padLeft(const std::string& text, size_t width) {
+        return std::string(width > displayWidth(text) ? width - displayWidth(text) : 1, ' ') + text;
+    }
+    static std::string fixed(double value, int digits) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+        return buffer;
+    }
+    static std::string milliseconds(int64_t ns) { return fixed(ns / 1e6, 2); }
+
+    std::atomic<bool> on{false};
+    bool counters = false;
+    bool countersFailed = false;
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    std::mutex mtx;
+    std::vector<std::unique_ptr<ThreadLog>> logs;
+};
+
+Profiler profiler;
+
+// Замер этапа в текущем потоке: от создания объекта до выхода из области видимости.
+// name должен жить до конца программы (строковый литерал)
+class ScopedPhase {
+public:
+    explicit ScopedPhase(const char* phaseName) {
+        if (!profiler.enabled()) {
+            return;
+        }
+        log = &profiler.threadLog();
+        name = phaseName;
+        if (log->countersOpen) {
+            log->perf.read(startCounters);
+        }
+        start = profiler.now();
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+    ~ScopedPhase() {
+        if (!log) {
+            return;
+        }
+        PhaseEvent event{name, log->index, start, profiler.now() - start, false, {}};
+        if (log->countersOpen && log->perf.read(event.counters)) {
+            event.hasCounters = true;
+            for (int i = 0; i < PerfCounters::count; ++i) {
+                event.counters[i] -= startCounters[i];
+            }
+        }
+        log->events.push_back(event);
+    }
+
+private:
+    Profiler::ThreadLog* log = nullptr;
+    const char* name = nullptr;
+    int64_t start = 0;
+    uint64_t startCounters[PerfCounters::count] = {};
+};
+
+// Хеш для поиска в словаре по std::string_view без создания std::string
+struct NameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+};
+
+// Словарь товаров: каждому названию сопоставляется плотный номер 0, 1, 2, ...
+class ProductDictionary {
+public:
+    static constexpr uint32_t npos = UINT32_MAX; // Признак отсутствующего товара
+
+    // Возвращает номер товара, при необходимости добавляя его в словарь
+    uint32_t intern(std::string_view name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        uint32_t id = static_cast<uint32_t>(names.size());
+        names.emplace_back(name);
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+    // Поиск номера товара без добавления (npos, если товара нет)
+    uint32_t find(std::string_view name) const {
+        auto it = ids.find(name);
+        return it == ids.end() ? npos : it->second;
+    }
+
+    const std::string& name(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+
+private:
+    std::vector<std::string> names; // Название по номеру
+    std::unordered_map<std::string, uint32_t, NameHash, std::equal_to<>> ids; // Номер по названию
+};
+
+// Представление позиций чеков по столбцам (без владения данными).
+// Позиции одного чека идут подряд.
+struct ReceiptView {
+    std::span<const int32_t> receiptId; // Номер чека
+    std::span<const uint32_t> productId; // Номер товара в словаре
+    std::span<const int32_t> price;     // Цена в копейках
+    std::span<const int32_t> quantity;  // Количество
+
+    size_t size() const { return productId.size(); }
+
+    // Позиции с номерами [begin, end)
+    ReceiptView slice(size_t begin, size_t end) const {
+        return {receiptId.subspan(begin, end - begin), productId.subspan(begin, end - begin),
+                price.subspan(begin, end - begin), quantity.subspan(begin, end - begin)};
+    }
+};
+
+// Столбцовое хранилище позиций чеков (структура массивов)
+struct ReceiptColumns {
+    std::vector<int32_t> receiptId;
+    std::vector<uint32_t> productId;
+    std::vector<int32_t> price;
+    std::vector<int32_t> quantity;
+    size_t receiptCount = 0; // Количество чеков
+
+    void push(int32_t receipt, uint32_t product, int32_t kopecks, int32_t count) {
+        receiptId.push_back(receipt);
+        productId.push_back(product);
+        price.push_back(kopecks);
+        quantity.push_back(count);
+    }
+
+    void resize(size_t items) {
+        receiptId.resize(items);
+        productId.resize(items);
+        price.resize(items);
+        quantity.resize(items);
+    }
+
+    size_t size() const { return productId.size(); }
+
+    ReceiptView view() const { return {receiptId, productId, price, quantity}; }
+};
+
+// Политика закрепления потоков пула за процессорами:
+//   Compact — потоки подряд на соседних логических CPU (сначала заполняется один узел и его ядра);
+//   Scatter — потоки по очереди на разных узлах и разных физических ядрах;
+//   Node    — потоки делятся на подряд идущие группы, каждая закрепляется за всеми CPU своего узла NUMA
+enum class AffinityPolicy { None, Compact, Scatter, Node };
+
+const char* affinityPolicyName(AffinityPolicy policy) {
+    switch (policy) {
+        case AffinityPolicy::Compact: return "compact";
+        case AffinityPolicy::Scatter: return "scatter";
+        case AffinityPolicy::Node: return "node";
+        default: return "none";
+    }
+}
+
+// Топология процессоров из sysfs: для каждого доступного процессу логического CPU —
+// узел NUMA, сокет и физическое ядро. Если sysfs недоступен, все CPU считаются одним узлом
+class CpuTopology {
+public:
+    struct Cpu {
+        int cpu;
+        int node = 0;
+        int package = 0;
+        int core = 0;
+    };
+
+    static CpuTopology detect() {
+        CpuTopology topology;
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            return topology;
+        }
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+                topology.list.push_back({cpu, 0, readNumber(base + "physical_package_id"), readNumber(base + "core_id", cpu)});
+            }
+        }
+        for (int node : parseCpuList(readLine("/sys/devices/system/node/online"))) {
+            for (int cpu : parseCpuList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"))) {
+                for (Cpu& c : topology.list) {
+                    if (c.cpu == cpu) {
+                        c.node = node;
+                    }
+                }
+            }
+        }
+        return topology;
+    }
+
+    const std::vector<Cpu>& cpus() const { return list; }
+
+    int nodeCount() const {
+        std::vector<int> nodes = nodeIds();
+        return static_cast<int>(nodes.size());
+    }
+
+    // Допустимые CPU для каждого из numWorkers потоков (пустой список — без закрепления)
+    std::vector<std::vector<int>> placement(AffinityPolicy policy, int numWorkers) const {
+        std::vector<std::vector<int>> result(numWorkers);
+        if (policy == AffinityPolicy::None || list.empty()) {
+            return result;
+        }
+        if (policy == AffinityPolicy::Node) {
+            std::vector<int> nodes = nodeIds();
+            for (int w = 0; w < numWorkers; ++w) {
+                int node = nodes[static_cast<size_t>(w) * nodes.size() / numWorkers];
+                for (const Cpu& c : list) {
+                    if (c.node == node) {
+                        result[w].push_back(c.cpu);
+                    }
+                }
+            }
+            return result;
+        }
+
+        std::vector<Cpu> order = list;
+        auto key = [](const Cpu& c) { return std::tuple(c.node, c.package, c.core, c.cpu); };
+        std::sort(order.begin(), order.end(), [&](const Cpu& a, const Cpu& b) { return key(a) < key(b); });
+        if (policy == AffinityPolicy::Scatter) {
+            // Сначала по одному логическому CPU на каждое физическое ядро, затем вторые гиперпотоки;
+            // внутри каждого «слоя» ядра разных узлов чередуются: (сосед, ядро в узле, узел, индекс)
+            std::vector<int> sibling(order.size()), coreInNode(order.size());
+            for (size_t i = 0; i < order.size(); ++i) {
+                for (size_t j = 0; j < i; ++j) {
+                    bool sameNode = order[j].node == order[i].node;
+                    sibling[i] += sameNode && order[j].package == order[i].package && order[j].core == order[i].core;
+                    coreInNode[i] += sameNode && sibling[j] == 0;
+                }
+            }
+            std::vector<std::tuple<int, int, int, size_t>> ranked;
+            for (size_t i = 0; i < order.size(); ++i) {
+                ranked.emplace_back(sibling[i], coreInNode[i], order[i].node, i);
+            }
+            std::sort(ranked.begin(), ranked.end());
+            std::vector<Cpu> scattered;
+            for (const auto& r : ranked) {
+                scattered.push_back(order[std::get<3>(r)]);
+            }
+            order = scattered;
+        }
+        for (int w = 0; w < numWorkers; ++w) {
+            result[w].push_back(order[w % order.size()].cpu);
+        }
+        return result;
+    }
+
+    int nodeOf(int cpu) const {
+        for (const Cpu& c : list) {
+            if (c.cpu == cpu) {
+                return c.node;
+            }
+        }
+        return 0;
+    }
+
+private:
+    std::vector<int> nodeIds() const {
+        std::vector<int> nodes;
+        for (const Cpu& c : list) {
+            nodes.push_back(c.node);
+        }
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+        return nodes;
+    }
+
+    static std::string readLine(const std::string& path) {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    static int readNumber(const std::string& path, int fallback = 0) {
+        std::string line = readLine(path);
+        return line.empty() ? fallback : std::atoi(line.c_str());
+    }
+
+    // Список вида "0-3,8,10-11"
+    static std::vector<int> parseCpuList(const std::string& text) {
+        std::vector<int> result;
+        const char* p = text.c_str();
+        while (*p) {
+            char* next;
+            long first = std::strtol(p, &next, 10);
+            if (next == p) {
+                break;
+            }
+            long last = first;
+            if (*next == '-') {
+                p = next + 1;
+                last = std::strtol(p, &next, 10);
+            }
+            for (long cpu = first; cpu <= last; ++cpu) {
+                result.push_back(static_cast<int>(cpu));
+            }
+            p = *next == ',' ? next + 1 : next;
+        }
+        return result;
+    }
+
+    std::vector<Cpu> list;
+};
+
+// Пул потоков с очередью задач у каждого потока и перехватом работы (work stealing).
+// Потоки создаются один раз и переиспользуются между запусками; вызывающий поток
+// участвует в работе как поток с номером 0
+class ThreadPool {
+public:
+    explicit ThreadPool(int numThreads) {
+        if (numThreads < 1) {
+            numThreads = 1;
+        }
+        for (int i = 0; i < numThreads; ++i) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+        for (int i = 1; i < numThreads; ++i) {
+            threads.emplace_back([this, i]() { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wakeCv.notify_all();
+        for (auto& t : threads) {
+            t.join();
+        }
+        if (callerMaskSaved) {
+            pthread_setaffinity_np(pthread_self(), sizeof(callerMask), &callerMask);
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    // Закрепляет потоки пула за процессорами: cpus[w] — допустимые CPU потока w (пустой
+    // список — без ограничений). Поток 0 — вызывающий, он закрепляется на время жизни пула:
+    // деструктор возвращает ему прежнюю маску.
+    // nodes[w] — узел NUMA потока w, по нему результаты сводятся сначала внутри узла
+    bool setAffinity(const std::vector<std::vector<int>>& cpus, const std::vector<int>& nodes) {
+        bool ok = true;
+        for (int w = 0; w < size() && w < static_cast<int>(cpus.size()); ++w) {
+            if (cpus[w].empty()) {
+                continue;
+            }
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : cpus[w]) {
+                CPU_SET(cpu, &set);
+            }
+            if (w == 0 && !callerMaskSaved) { // маску вызывающего потока вернёт деструктор
+                callerMaskSaved = pthread_getaffinity_np(pthread_self(), sizeof(callerMask), &callerMask) == 0;
+            }
+            pthread_t handle = w == 0 ? pthread_self() : threads[w - 1].native_handle();
+            ok = pthread_setaffinity_np(handle, sizeof(set), &set) == 0 && ok;
+        }
+        workerNodes = nodes;
+        workerNodes.resize(workers.size(), 0);
+        pinned = true;
+        return ok;
+    }
+
+    bool isPinned() const { return pinned; }
+
+    // Узел NUMA потока (0, если закрепления не было)
+    int nodeOf(int worker) const {
+        return worker < static_cast<int>(workerNodes.size()) ? workerNodes[worker] : 0;
+    }
+
+    // Выполняет fn(worker) ровно один раз в каждом потоке пула (без перехвата работы):
+    // нужно для действий, которые должны произойти именно в этом потоке, например
+    // для первого касания памяти на его узле
+    void forEachWorker(const std::function<void(int)>& fn) {
+        std::function<void(size_t, size_t, int)> task = [&](size_t, size_t, int worker) { fn(worker); };
+        stealing = false;
+        parallelFor(workers.size(), 1, task);
+        stealing = true;
+    }
+
+    // Выполняет fn(begin, end, worker) для всех диапазонов [0, count), разбитых по grain элементов.
+    // Диапазоны сначала раздаются потокам подряд идущими блоками, а освободившиеся потоки
+    // забирают оставшиеся диапазоны с дальнего конца чужих очередей. Возвращается после завершения всех
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t, int)>& fn) {
+        if (count == 0) {
+            return;
+        }
+        grain = std::max<size_t>(grain, 1);
+        size_t ranges = (count + grain - 1) / grain;
+        size_t perWorker = (ranges + workers.size() - 1) / workers.size();
+        for (size_t r = 0; r < ranges; ++r) {
+            Worker& worker = *workers[r / perWorker];
+            std::lock_guard<std::mutex> lock(worker.mtx);
+            worker.tasks.push_back({r * grain, std::min(count, (r + 1) * grain)});
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            job = &fn;
+            active = static_cast<int>(threads.size());
+            ++epoch;
+        }
+        wakeCv.notify_all();
+
+        runTasks(0);
+
+        // Ждём, пока остальные потоки закончат свои диапазоны
+        std::unique_lock<std::mutex> lock(mtx);
+        doneCv.wait(lock, [this]() { return active == 0; });
+        job = nullptr;
+    }
+
+private:
+    struct Range {
+        size_t begin;
+        size_t end;
+    };
+
+    // Очередь диапазонов потока (выравнивание исключает ложное разделение кеш-линий)
+    struct alignas(64) Worker {
+        std::mutex mtx;
+        std::deque<Range> tasks;
+    };
+
+    // Забираем диапазон из своей очереди с начала, иначе перехватываем с конца чужой
+    bool takeTask(int self, Range& range) {
+        {
+            Worker& own = *workers[self];
+            std::lock_guard<std::mutex> lock(own.mtx);
+            if (!own.tasks.empty()) {
+                range = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t k = 1; stealing && k < workers.size(); ++k) {
+            Worker& victim = *workers[(self + k) % workers.size()];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+            if (!victim.tasks.empty()) {
+                range = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void runTasks(int self) {
+        Range range;
+        while (takeTask(self, range)) {
+            (*job)(range.begin, range.end, self);
+        }
+    }
+
+    void workerLoop(int self) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wakeCv.wait(lock, [&]() { return stopping || epoch != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = epoch;
+            }
+            runTasks(self);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (--active == 0) {
+                    doneCv.notify_one();
+                }
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers; // Очереди потоков (0 — вызывающий поток)
+    std::vector<std::thread> threads;             // Рабочие потоки 1..N-1
+    const std::function<void(size_t, size_t, int)>* job = nullptr; // Текущее задание
+    std::mutex mtx;
+    std::condition_variable wakeCv; // Появилось новое задание или пул останавливается
+    std::condition_variable doneCv; // Все рабочие потоки закончили задание
+    uint64_t epoch = 0;  // Номер текущего задания
+    int active = 0;      // Сколько рабочих потоков ещё не закончили задание
+    bool stopping = false;
+    bool stealing = true;         // Меняется только между заданиями
+    bool pinned = false;
+    cpu_set_t callerMask;         // Маска вызывающего потока до закрепления
+    bool callerMaskSaved = false;
+    std::vector<int> workerNodes; // Узел NUMA каждого потока
+};
+
+// Закрепляет потоки пула по политике; узел потока — узел первого из его CPU
+bool applyAffinity(ThreadPool& pool, const CpuTopology& topology, AffinityPolicy policy) {
+    if (policy == AffinityPolicy::None) {
+        return true;
+    }
+    std::vector<std::vector<int>> cpus = topology.placement(policy, pool.size());
+    std::vector<int> nodes;
+    for (const std::vector<int>& set : cpus) {
+        nodes.push_back(set.empty() ? 0 : topology.nodeOf(set.front()));
+    }
+    return pool.setAffinity(cpus, nodes);
+}
+
+// Пропускная способность каждого узла NUMA: позиции, обработанные его потоками, в секунду
+std::string nodeThroughput(const ThreadPool& pool, const std::vector<size_t>& workerItems, double seconds) {
+    std::map<int, size_t> nodeItems;
+    for (size_t w = 0; w < workerItems.size(); ++w) {
+        nodeItems[pool.nodeOf(static_cast<int>(w))] += workerItems[w];
+    }
+    std::string result;
+    for (const auto& [node, count] : nodeItems) {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%sузел %d: %.1f млн/с", result.empty() ? "" : ", ", node,
+                      seconds > 0 ? count / seconds / 1e6 : 0.0);
+        result += buffer;
+    }
+    return result;
+}
+
+// Постоянная доля потока worker из numWorkers в диапазоне [0, count): так позиции делят
+// между потоками и PlacedColumns, и processMultiThread при закреплённых потоках
+inline std::pair<size_t, size_t> workerShare(size_t count, int worker, int numWorkers) {
+    return {count * worker / numWorkers, count * (worker + 1) / numWorkers};
+}
+
+// Копия столбцов позиций, каждую долю которой (workerShare) впервые записывает поток пула,
+// который обработает её в processMultiThread при закреплённых потоках. Массивы выделяются
+// без инициализации, поэтому страницы доли размещаются на узле NUMA её потока, а не на узле
+// загружавшего потока. Обработка сдвигает границы долей к началам чеков, так что чужими
+// остаются лишь позиции одного чека на каждой границе
+class PlacedColumns {
+public:
+    PlacedColumns() = default;
+
+    explicit PlacedColumns(ReceiptView items, ThreadPool& pool)
+        : count(items.size()), receiptId(new int32_t[count]), productId(new uint32_t[count]),
+          price(new int32_t[count]), quantity(new int32_t[count]) {
+        pool.forEachWorker([&](int worker) {
+            auto [begin, end] = workerShare(count, worker, pool.size());
+            std::copy(items.receiptId.begin() + begin, items.receiptId.begin() + end, receiptId.get() + begin);
+            std::copy(items.productId.begin() + begin, items.productId.begin() + end, productId.get() + begin);
+            std::copy(items.price.begin() + begin, items.price.begin() + end, price.get() + begin);
+            std::copy(items.quantity.begin() + begin, items.quantity.begin() + end, quantity.get() + begin);
+        });
+    }
+
+    ReceiptView view() const {
+        return {{receiptId.get(), count}, {productId.get(), count}, {price.get(), count}, {quantity.get(), count}};
+    }
+
+private:
+    size_t count = 0;
+    std::unique_ptr<int32_t[]> receiptId;
+    std::unique_ptr<uint32_t[]> productId;
+    std::unique_ptr<int32_t[]> price;
+    std::unique_ptr<int32_t[]> quantity;
+};
+
+// Буфер для форматирования вывода: числа записываются через std::to_chars,
+// без потоков ввода-вывода и без блокировок (у каждого потока свой буфер)
+class OutputBuffer {
+public:
+    explicit OutputBuffer(size_t capacity = 0) { data.reserve(capacity); }
+
+    void append(std::string_view text) { data.append(text); }
+
+    void appendNumber(long long value) {
+        char digits[24];
+        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+        data.append(digits, end);
+    }
+
+    // Цена в копейках печатается как в рублях без лишних нулей: 150 -> "1.5", 200 -> "2"
+    void appendPrice(long long kopecks) {
+        if (kopecks < 0) {
+            data.push_back('-');
+            kopecks = -kopecks;
+        }
+        appendNumber(kopecks / 100);
+        int fraction = static_cast<int>(kopecks % 100);
+        if (fraction != 0) {
+            data.push_back('.');
+            data.push_back(static_cast<char>('0' + fraction / 10));
+            if (fraction % 10 != 0) {
+                data.push_back(static_cast<char>('0' + fraction % 10));
+            }
+        }
+    }
+
+    std::string_view view() const { return data; }
+    size_t size() const { return data.size(); }
+
+private:
+    std::string data;
+};
+
+// Приёмник вывода результатов: получает готовые части текста и записывает их за один раз
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+    virtual bool write(const std::vector<std::string_view>& parts) = 0;
+};
+
+// Вывод в файловый дескриптор (стандартный вывод или файл) через writev
+class FdSink : public OutputSink {
+public:
+    // Вывод в стандартный поток
+    FdSink() : fd(STDOUT_FILENO), owned(false) {}
+
+    // Вывод в файл (файл создаётся заново)
+    explicit FdSink(const std::string& filename) : fd(::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)), owned(true) {
+        if (fd < 0) {
+            std::cerr << "Не удалось создать файл: " << filename << "\n";
+        }
+    }
+
+    ~FdSink() override {
+        if (owned && fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    bool write(const std::vector<std::string_view>& parts) override {
+        if (fd < 0) {
+            return false;
+        }
+        if (fd == STDOUT_FILENO) {
+            std::cout.flush(); // текст, уже выведенный через std::cout, должен идти раньше
+        }
+        std::vector<iovec> iov;
+        for (std::string_view part : parts) {
+            if (!part.empty()) {
+                iov.push_back({const_cast<char*>(part.data()), part.size()});
+            }
+        }
+        // writev принимает не больше IOV_MAX частей и может записать не всё
+        size_t first = 0;
+        while (first < iov.size()) {
+            int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+            ssize_t n = ::writev(fd, iov.data() + first, count);
+            if (n < 0) {
+                return false;
+            }
+            size_t written = static_cast<size_t>(n);
+            while (first < iov.size() && written >= iov[first].iov_len) {
+                written -= iov[first].iov_len;
+                ++first;
+            }
+            if (written > 0) {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + written;
+                iov[first].iov_len -= written;
+            }
+        }
+        return true;
+    }
+
+private:
+    int fd;
+    bool owned; // Закрывать ли дескриптор в деструкторе
+};
+
+// Приёмник, который отбрасывает вывод (для замеров без ввода-вывода)
+class NullSink : public OutputSink {
+public:
+    bool write(const std::vector<std::string_view>&) override { return true; }
+};
+
+// Режим вывода результатов
+enum class OutputMode {
+    Full,    // Итоги по товарам и список чеков каждого товара
+    Summary, // Только итоги по товарам
+};
+
+// Время, затраченное на вывод результатов
+struct PrintStats {
+    double formatSeconds = 0; // Форматирование в буферы
+    double ioSeconds = 0;     // Запись в приёмник
+    size_t bytes = 0;         // Размер выведенного текста
+};
+
+// Чек и цена позиции в списке чеков товара
+struct ReceiptRef {
+    int32_t receiptId; // Номер чека
+    int32_t price;     // Цена в копейках
+};
+
+// Список записей о чеках, растущий блоками из арены (memory_resource) потока. В отличие
+// от вектора, рост не копирует уже записанное и не оставляет в арене брошенных буферов,
+// поэтому арена занимает ровно столько, сколько записано, с точностью до последнего блока
+class ArenaReceiptList {
+public:
+    explicit ArenaReceiptList(std::pmr::memory_resource* resource) : arena(resource) {}
+
+    void push_back(const ReceiptRef& ref) {
+        if (next == blockEnd) {
+            grow();
+        }
+        *next++ = ref;
+        ++count;
+    }
+
+    size_t size() const { return count; }
+
+    // Дописывает записи другого списка (в его порядке)
+    void append(const ArenaReceiptList& other) {
+        for (size_t i = 0; i < other.blocks.size(); ++i) {
+            const ReceiptRef* end = i + 1 == other.blocks.size() ? other.next : other.blocks[i].data() + other.blocks[i].size();
+            for (const ReceiptRef* p = other.blocks[i].data(); p != end; ++p) {
+                push_back(*p);
+            }
+        }
+    }
+
+    // Дописывает записи в конец вектора в порядке добавления
+    template <class Vector>
+    void appendTo(Vector& out) const {
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            ReceiptRef* end = i + 1 == blocks.size() ? next : blocks[i].data() + blocks[i].size();
+            out.insert(out.end(), blocks[i].data(), end);
+        }
+    }
+
+private:
+    void grow() {
+        size_t capacity = blocks.empty() ? 64 : std::min<size_t>(blocks.back().size() * 2, 65536);
+        next = static_cast<ReceiptRef*>(arena->allocate(capacity * sizeof(ReceiptRef), alignof(ReceiptRef)));
+        blockEnd = next + capacity;
+        blocks.emplace_back(next, capacity);
+    }
+
+    std::pmr::memory_resource* arena;
+    std::vector<std::span<ReceiptRef>> blocks; // Блоки по порядку заполнения
+    ReceiptRef* next = nullptr;     // Свободное место в последнем блоке
+    ReceiptRef* blockEnd = nullptr;
+    size_t count = 0;
+};
+
+// Вывод отчёта по товарам: для каждого товара с номером от 0 до numProducts - 1 печатается
+// итог и (в режиме Full) список чеков. Текст форматируется параллельно в отдельные буферы
+// (каждый товар, а длинные списки чеков — частями) и записывается в sink за один раз.
+// nameOf, quantityOf и receiptsOf возвращают название, итог и список чеков товара
+template <typename NameOf, typename QuantityOf, typename ReceiptsOf>
+PrintStats writeProductReport(OutputSink& sink, ThreadPool& pool, OutputMode mode, size_t numProducts,
+                              NameOf&& nameOf, QuantityOf&& quantityOf, ReceiptsOf&& receiptsOf) {
+    const size_t piece = 1 << 16; // Сколько чеков форматирует одна задача
+
+    // Части вывода: товар и диапазон его списка чеков; первая часть товара печатает заголовок
+    struct Piece {
+        uint32_t product;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Piece> pieces;
+    for (size_t product = 0; product < numProducts; ++product) {
+        size_t count = receiptsOf(static_cast<uint32_t>(product)).size();
+        if (count == 0) {
+            continue; // Товар не встречался в обработанных чеках
+        }
+        size_t listed = mode == OutputMode::Full ? count : 0;
+        size_t begin = 0;
+        do {
+            pieces.push_back({static_cast<uint32_t>(product), begin, std::min(listed, begin + piece)});
+            begin += piece;
+        } while (begin < listed);
+    }
+
+    PrintStats stats;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<OutputBuffer> buffers(pieces.size());
+    pool.parallelFor(pieces.size(), 1, [&](size_t begin, size_t end, int) {
+        ScopedPhase phase("форматирование");
+        for (size_t i = begin; i < end; ++i) {
+            const Piece& p = pieces[i];
+            OutputBuffer& out = buffers[i];
+            out = OutputBuffer((p.end - p.begin) * 40 + 256);
+            if (p.begin == 0) {
+                const std::string& name = nameOf(p.product);
+                out.append("Товар: ");
+                out.append(name);
+                out.append(", Общее количество продано: ");
+                out.appendNumber(quantityOf(p.product));
+                out.append("\n");
+                if (mode == OutputMode::Full) {
+                    out.append("Чеки, содержащие ");
+                    out.append(name);
+                    out.append(":\n");
+                }
+            }
+            std::span<const ReceiptRef> receipts = receiptsOf(p.product);
+            for (size_t j = p.begin; j < p.end; ++j) {
+                out.append(" - Номер чека: ");
+                out.appendNumber(receipts[j].receiptId);
+                out.append(", Цена: ");
+                out.appendPrice(receipts[j].price);
+                out.append("\n");
+            }
+        }
+    });
+    std::vector<std::string_view> parts;
+    for (const auto& buffer : buffers) {
+        parts.push_back(buffer.view());
+        stats.bytes += buffer.size();
+    }
+    auto formatted = std::chrono::high_resolution_clock::now();
+    {
+        ScopedPhase phase("запись вывода");
+        sink.write(parts);
+    }
+    auto written = std::chrono::high_resolution_clock::now();
+
+    stats.formatSeconds = std::chrono::duration<double>(formatted - start).count();
+    stats.ioSeconds = std::chrono::duration<double>(written - formatted).count();
+    return stats;
+}
+
+// Граница целых чеков не раньше pos: сама pos, если с неё начинается чек (или это 0 либо
+// конец), иначе первая позиция следующего чека
+inline size_t receiptBoundary(ReceiptView items, size_t pos) {
+    while (pos > 0 && pos < items.size() && items.receiptId[pos] == items.receiptId[pos - 1]) {
+        ++pos;
+    }
+    return pos;
+}
+
+// Обработка всех позиций потоками пула: каждый поток берёт диапазоны целых чеков
+// и передаёт чеки по одному в fn
+template <class Fn>
+void forEachReceiptParallel(ReceiptView items, ThreadPool& pool, size_t grain, Fn&& fn) {
+    pool.parallelFor(items.size(), grain, [&](size_t begin, size_t end, int) {
+        begin = receiptBoundary(items, begin);
+        end = receiptBoundary(items, end);
+        while (begin < end) {
+            size_t next = begin + 1;
+            while (next < end && items.receiptId[next] == items.receiptId[begin]) {
+                ++next;
+            }
+            fn(items.slice(begin, next));
+            begin = next;
+        }
+    });
+}
+
+// Итоги по набору чеков
+struct RangeTotals {
+    long long quantity = 0; // Количество товара
+    long long revenue = 0;  // Выручка в копейках
+    size_t receipts = 0;    // Различных чеков
+};
+
+// Накопленные суммы по возрастанию номера чека: итоги по диапазону номеров — разность двух
+// накопленных значений, найденных двоичным поиском, то есть O(log n). Позиции одного чека,
+// пришедшие подряд, сливаются в одну запись. Каждая запись накапливается от предыдущей,
+// поэтому если чеки пришли не по порядку (пакеты из нескольких потоков), приращения
+// восстанавливаются разностями соседних записей и order() пересчитывает суммы заново
+class PrefixSeries {
+public:
+    void add(int32_t receiptId, long long quantity, long long revenue) {
+        if (!ids.empty() && ids.back() == receiptId) {
+            quantities.back() += quantity;
+            revenues.back() += revenue;
+            return;
+        }
+        sorted = sorted && (ids.empty() || ids.back() < receiptId);
+        ids.push_back(receiptId);
+        quantities.push_back((quantities.empty() ? 0 : quantities.back()) + quantity);
+        revenues.push_back((revenues.empty() ? 0 : revenues.back()) + revenue);
+    }
+
+    // Упорядочивает записи по номеру чека и сливает записи одного чека
+    void order() {
+        if (sorted) {
+            return;
+        }
+        std::vector<uint32_t> permutation(ids.size());
+        std::iota(permutation.begin(), permutation.end(), 0);
+        std::stable_sort(permutation.begin(), permutation.end(), [&](uint32_t a, uint32_t b) { return ids[a] < ids[b]; });
+        PrefixSeries ordered;
+        ordered.ids.reserve(ids.size());
+        ordered.quantities.reserve(ids.size());
+        ordered.revenues.reserve(ids.size());
+        for (uint32_t i : permutation) {
+            ordered.add(ids[i], quantities[i] - (i > 0 ? quantities[i - 1] : 0), revenues[i] - (i > 0 ? revenues[i - 1] : 0));
+        }
+        *this = std::move(ordered);
+    }
+
+    // Итоги по чекам с номерами из [from, to] (записи должны быть упорядочены)
+    RangeTotals range(int32_t from, int32_t to) const {
+        size_t first = std::lower_bound(ids.begin(), ids.end(), from) - ids.begin();
+        size_t last = std::upper_bound(ids.begin(), ids.end(), to) - ids.begin();
+        if (first >= last) {
+            return {};
+        }
+        long long quantityBefore = first > 0 ? quantities[first - 1] : 0;
+        long long revenueBefore = first > 0 ? revenues[first - 1] : 0;
+        return {quantities[last - 1] - quantityBefore, revenues[last - 1] - revenueBefore, last - first};
+    }
+
+    // Итоги по всем чекам
+    RangeTotals total() const {
+        return ids.empty() ? RangeTotals{} : RangeTotals{quantities.back(), revenues.back(), ids.size()};
+    }
+
+    bool empty() const { return ids.empty(); }
+    int32_t lastId() const { return ids.back(); }
+
+    size_t memoryBytes() const {
+        return ids.capacity() * sizeof(int32_t) + (quantities.capacity() + revenues.capacity()) * sizeof(long long);
+    }
+
+private:
+    std::vector<int32_t> ids;           // Номера чеков
+    std::vector<long long> quantities;  // Накопленное количество
+    std::vector<long long> revenues;    // Накопленная выручка в копейках
+    bool sorted = true;
+};
+
+// Оценка числа различных значений (HyperLogLog). Хеш значения делится на номер регистра
+// (старшие precision бит) и ранг — номер первой единицы в остальных битах; регистр хранит
+// наибольший встреченный ранг. Сумма 2^-регистр и число нулевых регистров обновляются при
+// каждом изменении регистра, поэтому оценка получается за O(1). Относительная погрешность
+// около 1.04 / sqrt(2^precision): 1.6% для 12 бит при 4 КБ памяти
+class HyperLogLog {
+public:
+    explicit HyperLogLog(int precision = 12)
+        : precision(precision), registers(size_t(1) << precision, 0), inverseSum(registers.size()), zeros(registers.size()) {}
+
+    // Перемешивание splitmix64: соседние номера чеков дают независимые хеши
+    static uint64_t hash(uint64_t value) {
+        value += 0x9e3779b97f4a7c15ULL;
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    void add(uint64_t hashValue) {
+        uint8_t& reg = registers[hashValue >> (64 - precision)];
+        // Единица ниже сдвинутых бит ограничивает ранг, если остальные биты хеша нулевые
+        uint8_t rank = static_cast<uint8_t>(std::countl_zero((hashValue << precision) | (uint64_t(1) << (precision - 1))) + 1);
+        if (rank > reg) {
+            inverseSum += std::ldexp(1.0, -rank) - std::ldexp(1.0, -reg);
+            zeros -= reg == 0;
+            reg = rank;
+        }
+    }
+
+    double estimate() const {
+        double m = static_cast<double>(registers.size());
+        double raw = 0.7213 / (1 + 1.079 / m) * m * m / inverseSum;
+        if (raw <= 2.5 * m && zeros > 0) {
+            return m * std::log(m / zeros); // линейный подсчёт точнее для небольших множеств
+        }
+        return raw;
+    }
+
+    size_t memoryBytes() const { return registers.capacity(); }
+
+private:
+    int precision;
+    std::vector<uint8_t> registers;
+    double inverseSum; // Сумма 2^-регистр по всем регистрам
+    size_t zeros;      // Число нулевых регистров
+};
+
+// Самые весомые ключи потока в памяти O(capacity) (Space-Saving). Отслеживается не больше
+// capacity ключей; новый ключ при занятых счётчиках вытесняет ключ с наименьшим счётом
+// и наследует этот счёт как погрешность. Счётчики лежат в куче с наименьшим наверху,
+// позиция ключа в куче хранится в массиве по номеру ключа, поэтому добавление стоит
+// O(log capacity). Счёт завышен не больше чем на error, а ключ с весом больше
+// total / capacity отслеживается всегда. Веса не должны быть отрицательными
+class SpaceSaving {
+public:
+    struct Counter {
+        uint32_t key;
+        long long count;
+        long long error; // Наибольшее завышение счёта
+    };
+
+    explicit SpaceSaving(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+    void add(uint32_t key, long long weight) {
+        if (key >= position.size()) {
+            position.resize(key + 1, npos);
+        }
+        size_t slot = position[key];
+        if (slot == npos && heap.size() < capacity) {
+            heap.push_back({key, weight, 0});
+            position[key] = heap.size() - 1;
+            siftUp(heap.size() - 1);
+            return;
+        }
+        if (slot == npos) { // вытесняем ключ с наименьшим счётом
+            slot = 0;
+            position[heap[0].key] = npos;
+            heap[0] = {key, heap[0].count, heap[0].count};
+            position[key] = 0;
+        }
+        heap[slot].count += weight;
+        siftDown(slot);
+    }
+
+    // k ключей с наибольшим счётом, по убыванию счёта
+    std::vector<Counter> top(size_t k) const {
+        std::vector<Counter> result(heap);
+        k = std::min(k, result.size());
+        std::partial_sort(result.begin(), result.begin() + k, result.end(), [](const Counter& a, const Counter& b) {
+            return a.count != b.count ? a.count > b.count : a.key < b.key;
+        });
+        result.resize(k);
+        return result;
+    }
+
+    size_t memoryBytes() const {
+        return heap.capacity() * sizeof(Counter) + position.capacity() * sizeof(size_t);
+    }
+
+private:
+    static constexpr size_t npos = SIZE_MAX;
+
+    void swapSlots(size_t a, size_t b) {
+        std::swap(heap[a], heap[b]);
+        position[heap[a].key] = a;
+        position[heap[b].key] = b;
+    }
+
+    void siftUp(size_t slot) {
+        while (slot > 0 && heap[slot].count < heap[(slot - 1) / 2].count) {
+            swapSlots(slot, (slot - 1) / 2);
+            slot = (slot - 1) / 2;
+        }
+    }
+
+    void siftDown(size_t slot) {
+        for (;;) {
+            size_t smallest = slot;
+            for (size_t child = 2 * slot + 1; child <= 2 * slot + 2 && child < heap.size(); ++child) {
+                if (heap[child].count < heap[smallest].count) {
+                    smallest = child;
+                }
+            }
+            if (smallest == slot) {
+                return;
+            }
+            swapSlots(slot, smallest);
+            slot = smallest;
+        }
+    }
+
+    size_t capacity;
+    std::vector<Counter> heap;
+    std::vector<size_t> position; // Позиция ключа в куче по номеру ключа
+};
+
+// Аналитические запросы к продажам без повторного просмотра позиций. Структуры пополняются
+// за один проход по пакетам позиций (add) и затем отвечают на запросы:
+//   итоги товара или всех товаров по диапазону номеров чеков — накопленные суммы, O(log n);
+//   самые продаваемые товары по выручке и количеству — Space-Saving, O(capacity) на запрос;
+//   число различных чеков с товаром — HyperLogLog, O(1).
+// Точное число чеков с товаром тоже известно (число записей накопленных сумм) — с ним
+// сверяется оценка HyperLogLog, которая нужна, когда точные структуры не помещаются в память
+class SalesAnalytics {
+public:
+    explicit SalesAnalytics(size_t sketchCapacity = 256, int hllPrecision = 12)
+        : revenueTop(sketchCapacity), quantityTop(sketchCapacity), hllPrecision(hllPrecision) {}
+
+    void add(ReceiptView batch) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            uint32_t product = batch.productId[i];
+            int32_t receiptId = batch.receiptId[i];
+            long long quantity = batch.quantity[i];
+            long long revenue = static_cast<long long>(batch.price[i]) * batch.quantity[i];
+            if (product >= products.size()) {
+                products.resize(product + 1);
+                distinct.resize(product + 1, HyperLogLog(hllPrecision));
+            }
+            PrefixSeries& series = products[product];
+            if (series.empty() || series.lastId() != receiptId) {
+                distinct[product].add(HyperLogLog::hash(static_cast<uint32_t>(receiptId)));
+            }
+            series.add(receiptId, quantity, revenue);
+            overall.add(receiptId, quantity, revenue);
+            revenueTop.add(product, revenue);
+            quantityTop.add(product, quantity);
+            minId = std::min(minId, receiptId);
+            maxId = std::max(maxId, receiptId);
+        }
+    }
+
+    // Упорядочивает накопленные суммы по номеру чека (нужно, если пакеты добавлялись из нескольких потоков)
+    void order(ThreadPool& pool) {
+        overall.order();
+        pool.parallelFor(products.size(), 1, [&](size_t begin, size_t end, int) {
+            for (size_t product = begin; product < end; ++product) {
+                products[product].order();
+            }
+        });
+    }
+
+    // Итоги товара по чекам с номерами из [from, to]
+    RangeTotals productRange(uint32_t product, int32_t from, int32_t to) const {
+        return product < products.size() ? products[product].range(from, to) : RangeTotals{};
+    }
+
+    // Итоги всех товаров по чекам с номерами из [from, to]
+    RangeTotals range(int32_t from, int32_t to) const { return overall.range(from, to); }
+
+    // Точные итоги товара по всем чекам
+    RangeTotals productTotals(uint32_t product) const {
+        return product < products.size() ? products[product].total() : RangeTotals{};
+    }
+
+    // Оценка числа различных чеков с товаром
+    double distinctReceipts(uint32_t product) const {
+        return product < distinct.size() ? distinct[product].estimate() : 0;
+    }
+
+    // Самые продаваемые товары (ключ счётчика — номер товара)
+    std::vector<SpaceSaving::Counter> topByRevenue(size_t k) const { return revenueTop.top(k); }
+    std::vector<SpaceSaving::Counter> topByQuantity(size_t k) const { return quantityTop.top(k); }
+
+    size_t productCount() const { return products.size(); }
+    int32_t minReceiptId() const { return minId; }
+    int32_t maxReceiptId() const { return maxId; }
+
+    size_t prefixBytes() const {
+        size_t bytes = overall.memoryBytes();
+        for (const auto& series : products) {
+            bytes += series.memoryBytes();
+        }
+        return bytes;
+    }
+
+    size_t sketchBytes() const {
+        size_t bytes = revenueTop.memoryBytes() + quantityTop.memoryBytes();
+        for (const auto& sketch : distinct) {
+            bytes += sketch.memoryBytes();
+        }
+        return bytes;
+    }
+
+private:
+    std::vector<PrefixSeries> products; // Накопленные суммы по номеру товара
+    PrefixSeries overall;               // Накопленные суммы по всем товарам
+    std::vector<HyperLogLog> distinct;  // Различные чеки по номеру товара
+    SpaceSaving revenueTop;
+    SpaceSaving quantityTop;
+    int hllPrecision;
+    int32_t minId = INT32_MAX;
+    int32_t maxId = INT32_MIN;
+};
+
+// Класс для обработки данных о покупках
+class SalesProcessor {
+private:
+    const ProductDictionary& dictionary; // Названия товаров
+    ReceiptView items; // Позиции всех чеков
+    // Контейнеры результатов берут память из memory_resource: по умолчанию из общей кучи,
+    // а при передаче арены — из её больших блоков, которые освобождаются разом
+    using QuantityList = std::pmr::vector<long long>;
+    using ReceiptLists = std::pmr::vector<std::pmr::vector<ReceiptRef>>;
+    QuantityList totalProductQuantity; // Суммарное количество проданных товаров по номеру товара
+    ReceiptLists productReceipts; // Чеки, в которых присутствует товар, по номеру товара
+    std::vector<size_t> workerItems; // Позиции, обработанные каждым потоком (последний processMultiThread)
+    std::mutex mtx; // Мьютекс для синхронизации доступа к общим данным при добавлении пакетов из нескольких потоков
+    std::condition_variable batchTurn; // Очередь пакетов с порядковыми номерами
+    size_t nextBatch = 0;              // Номер пакета, который добавляется следующим
+    SalesAnalytics* analytics = nullptr; // Структуры для аналитических запросов, пополняемые вместе с результатами
+
+public:
+    // Конструктор, инициализирующий объект позициями чеков (данные не копируются)
+    SalesProcessor(const ProductDictionary& dict, ReceiptView view, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : dictionary(dict), items(view), totalProductQuantity(dict.size(), resource), productReceipts(dict.size(), resource) {}
+
+    // Конструктор для пополняемого режима: чеки поступают пакетами через append
+    explicit SalesProcessor(const ProductDictionary& dict, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : SalesProcessor(dict, ReceiptView{}, resource) {}
+
+    // Добавление пакета позиций к уже посчитанным результатам. Пакет сначала сводится
+    // в локальные массивы, а общие данные блокируются один раз на пакет, поэтому метод
+    // можно вызывать из нескольких потоков одновременно. Если у пакетов есть порядковые
+    // номера sequence (0, 1, 2, ...), сведение идёт параллельно, а в общие списки пакеты
+    // попадают строго по порядку номеров — так же, как при добавлении из одного потока
+    void append(ReceiptView batch, size_t sequence = SIZE_MAX) {
+        if (batch.size() == 0) {
+            if (sequence != SIZE_MAX) {
+                std::unique_lock<std::mutex> lock(mtx);
+                batchTurn.wait(lock, [&]() { return nextBatch == sequence; });
+                ++nextBatch;
+                batchTurn.notify_all();
+            }
+            return;
+        }
+        size_t numProducts = *std::max_element(batch.productId.begin(), batch.productId.end()) + 1;
+        // Локальные списки пакета растут в арене: один-два блока из кучи вместо выделения на каждый рост
+        std::pmr::monotonic_buffer_resource arena(batch.size() * sizeof(ReceiptRef) + numProducts * 1024);
+        QuantityList localQuantity(numProducts, &arena);
+        LocalReceiptLists localReceipts = makeLocalLists(numProducts, &arena);
+        processRange(batch, localQuantity, localReceipts);
+
+        std::unique_lock<std::mutex> lock(mtx);
+        if (sequence != SIZE_MAX) {
+            batchTurn.wait(lock, [&]() { return nextBatch == sequence; });
+        }
+        if (totalProductQuantity.size() < numProducts) { // в пакете встретились новые товары
+            totalProductQuantity.resize(numProducts);
+            productReceipts.resize(numProducts);
+        }
+        for (size_t product = 0; product < numProducts; ++product) {
+            totalProductQuantity[product] += localQuantity[product];
+            localReceipts[product].appendTo(productReceipts[product]);
+        }
+        if (analytics) {
+            analytics->add(batch);
+        }
+        if (sequence != SIZE_MAX) {
+            ++nextBatch;
+            batchTurn.notify_all();
+        }
+    }
+
+    // Подключение аналитики: последующие append и processSingleThread пополняют и её
+    void attachAnalytics(SalesAnalytics* target) {
+        analytics = target;
+    }
+
+    // Упорядочивает списки чеков по номеру чека (нужно, если пакеты добавлялись из нескольких
+    // потоков без номеров или номера чеков в данных шли не по порядку). Сортировка устойчивая:
+    // позиции с одинаковым номером чека остаются в порядке добавления
+    void orderReceiptLists(ThreadPool& pool) {
+        auto byReceipt = [](const ReceiptRef& a, const ReceiptRef& b) { return a.receiptId < b.receiptId; };
+        pool.parallelFor(productReceipts.size(), 1, [&](size_t begin, size_t end, int) {
+            for (size_t product = begin; product < end; ++product) {
+                auto& receipts = productReceipts[product];
+                if (!std::is_sorted(receipts.begin(), receipts.end(), byReceipt)) {
+                    std::stable_sort(receipts.begin(), receipts.end(), byReceipt);
+                }
+            }
+        });
+        if (analytics) {
+            analytics->order(pool);
+        }
+    }
+
+    // Число различных номеров чеков во всех списках (списки упорядочены orderReceiptLists).
+    // Списки сливаются через кучу из первых непросмотренных записей, поэтому номера всех
+    // чеков в памяти не собираются
+    size_t distinctReceiptCount() const {
+        using Head = std::pair<int32_t, uint32_t>; // Номер чека и номер товара
+        std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+        std::vector<size_t> next(productReceipts.size(), 0);
+        for (uint32_t product = 0; product < productReceipts.size(); ++product) {
+            if (!productReceipts[product].empty()) {
+                heads.push({productReceipts[product][0].receiptId, product});
+            }
+        }
+        size_t distinct = 0;
+        bool any = false;
+        int32_t last = 0;
+        while (!heads.empty()) {
+            auto [receiptId, product] = heads.top();
+            heads.pop();
+            distinct += !any || receiptId != last;
+            any = true;
+            last = receiptId;
+            const auto& receipts = productReceipts[product];
+            if (++next[product] < receipts.size()) {
+                heads.push({receipts[next[product]].receiptId, product});
+            }
+        }
+        return distinct;
+    }
+
+    // Однопоточная обработка данных (результаты выводятся отдельно через printResults)
+    void processSingleThread() {
+        processRange(items, totalProductQuantity, productReceipts); // Обрабатываем все позиции по порядку
+        if (analytics) {
+            analytics->add(items);
+        }
+    }
+
+    // Многопоточная обработка данных на пуле потоков: позиции делятся на небольшие
+    // диапазоны, которые свободные потоки перехватывают друг у друга
+    void processMultiThread(ThreadPool& pool, size_t grain = 16384) {
+        int numThreads = pool.size();
+        size_t numProducts = dictionary.size();
+
+        // У каждого потока своя арена: рост локальных списков не обращается к общему распределителю,
+        // а вся их память освобождается одним разом в конце. Состояние создаёт сам поток при первом
+        // диапазоне, поэтому при закреплении потоков память первого касания оказывается на его узле
+        size_t expectedBytes = items.size() / numThreads * sizeof(ReceiptRef) + numProducts * 1024;
+        std::vector<std::unique_ptr<LocalState>> local(numThreads);
+
+        auto processPart = [&](size_t begin, size_t end, int worker) {
+            // Чек целиком обрабатывается одним диапазоном, поэтому границы сдвигаются к началу следующего чека
+            ScopedPhase phase("агрегация");
+            if (!local[worker]) {
+                local[worker] = std::make_unique<LocalState>(numProducts, expectedBytes);
+            }
+            begin = receiptBoundary(items, begin);
+            end = receiptBoundary(items, end);
+            processRange(items.slice(begin, end), local[worker]->quantities, local[worker]->receipts);
+            local[worker]->items += end - begin;
+        };
+        if (pool.isPinned()) {
+            // Закреплённые потоки берут постоянные доли без перехвата — те, что разместил PlacedColumns
+            pool.forEachWorker([&](int worker) {
+                auto [begin, end] = workerShare(items.size(), worker, numThreads);
+                processPart(begin, end, worker);
+            });
+        } else {
+            pool.parallelFor(items.size(), grain, processPart);
+        }
+
+        workerItems.assign(numThreads, 0);
+        for (int i = 0; i < numThreads; ++i) {
+            workerItems[i] = local[i] ? local[i]->items : 0;
+        }
+
+        // Источники для общего слияния: потоки, а при закреплённых потоках на нескольких узлах
+        // NUMA — части узлов. Потоки узла сводят результаты своего узла в память этого узла,
+        // и общее слияние читает каждый товар с узла одним списком, а не по одному на поток.
+        // На одном узле сведение было бы лишним копированием, поэтому оно пропускается
+        std::vector<LocalState*> sources;
+        std::vector<std::unique_ptr<LocalState>> nodeStates(numThreads); // По номеру сводящего потока
+        std::vector<int> nodes;
+        for (int i = 0; i < numThreads; ++i) {
+            if (std::find(nodes.begin(), nodes.end(), pool.nodeOf(i)) == nodes.end()) {
+                nodes.push_back(pool.nodeOf(i));
+            }
+        }
+        if (pool.isPinned() && nodes.size() > 1) {
+            // Товары узла делятся между его потоками: каждый поток сводит свою часть товаров
+            // со всех потоков узла в свою арену, поэтому сведение идёт параллельно внутри узла
+            pool.forEachWorker([&](int worker) {
+                int node = pool.nodeOf(worker);
+                int rank = 0;
+                int nodeThreads = 0;
+                size_t nodeItems = 0;
+                for (int i = 0; i < numThreads; ++i) {
+                    if (pool.nodeOf(i) == node) {
+                        rank += i < worker;
+                        ++nodeThreads;
+                        nodeItems += workerItems[i];
+                    }
+                }
+                ScopedPhase phase("сведение по узлу");
+                size_t first = numProducts * rank / nodeThreads;
+                size_t last = numProducts * (rank + 1) / nodeThreads;
+                auto state = std::make_unique<LocalState>(numProducts, nodeItems / nodeThreads * sizeof(ReceiptRef) + numProducts * 1024);
+                for (int i = 0; i < numThreads; ++i) {
+                    if (pool.nodeOf(i) != node || !local[i]) {
+                        continue;
+                    }
+                    for (size_t product = first; product < last; ++product) {
+                        state->quantities[product] += local[i]->quantities[product];
+                        state->receipts[product].append(local[i]->receipts[product]);
+                    }
+                }
+                nodeStates[worker] = std::move(state);
+            });
+            local.clear(); // арены потоков больше не нужны
+            for (auto& state : nodeStates) {
+                if (state) {
+                    sources.push_back(state.get());
+                }
+            }
+        } else {
+            for (auto& state : local) {
+                if (state) {
+                    sources.push_back(state.get());
+                }
+            }
+        }
+
+        // Слияние локальных данных тоже параллельное: каждый товар сливается отдельной задачей.
+        // Диапазоны могли достаться потокам в любом порядке, поэтому списки чеков упорядочиваются
+        // по номеру чека (устойчиво, чтобы позиции внутри чека остались в порядке файла)
+        pool.parallelFor(numProducts, 1, [&](size_t begin, size_t end, int) {
+            ScopedPhase phase("слияние");
+            for (size_t product = begin; product < end; ++product) {
+                size_t total = 0;
+                for (LocalState* source : sources) {
+                    totalProductQuantity[product] += source->quantities[product]; // Суммируем количество проданных товаров
+                    total += source->receipts[product].size();
+                }
+                auto& receipts = productReceipts[product];
+                receipts.reserve(total);
+                for (LocalState* source : sources) {
+                    source->receipts[product].appendTo(receipts); // Объединяем данные о чеках
+                }
+                std::stable_sort(receipts.begin(), receipts.end(), [](const ReceiptRef& a, const ReceiptRef& b) {
+                    return a.receiptId < b.receiptId;
+                });
+            }
+        });
+    }
+
+    // Сколько позиций обработал каждый поток в последнем вызове processMultiThread
+    const std::vector<size_t>& itemsPerWorker() const { return workerItems; }
+
+    // Локальные списки чеков по номеру товара, растущие в арене потока
+    using LocalReceiptLists = std::vector<ArenaReceiptList>;
+
+    static LocalReceiptLists makeLocalLists(size_t numProducts, std::pmr::memory_resource* arena) {
+        return LocalReceiptLists(numProducts, ArenaReceiptList(arena));
+    }
+
+    // Локальные результаты потока (или узла NUMA): арена и массивы в ней
+    struct LocalState {
+        std::pmr::monotonic_buffer_resource arena;
+        QuantityList quantities;
+        LocalReceiptLists receipts;
+        size_t items = 0; // Обработано позиций
+
+        LocalState(size_t numProducts, size_t expectedBytes)
+            : arena(expectedBytes), quantities(numProducts, &arena), receipts(makeLocalLists(numProducts, &arena)) {}
+    };
+
+    // Обработка набора позиций: индексные сложения в плоские массивы по номеру товара
+    template <class Lists>
+    static void processRange(ReceiptView range, QuantityList& quantities, Lists& receipts) {
+        for (size_t i = 0; i < range.size(); ++i) {
+            uint32_t product = range.productId[i];
+            quantities[product] += range.quantity[i]; // Увеличиваем количество проданных товаров
+            receipts[product].push_back({range.receiptId[i], range.price[i]}); // Добавляем информацию о чеке
+        }
+    }
+
+    // Вывод результатов обработки. Текст форматируется параллельно в отдельные буферы
+    // и записывается в sink за один раз (см. writeProductReport)
+    PrintStats printResults(OutputSink& sink, ThreadPool& pool, OutputMode mode = OutputMode::Full) const {
+        return writeProductReport(sink, pool, mode, totalProductQuantity.size(),
+            [&](uint32_t product) -> const std::string& { return dictionary.name(product); },
+            [&](uint32_t product) { return totalProductQuantity[product]; },
+            [&](uint32_t product) { return std::span<const ReceiptRef>(productReceipts[product]); });
+    }
+
+    // Суммарное количество проданного товара
+    long long quantityOf(uint32_t product) const {
+        return product < totalProductQuantity.size() ? totalProductQuantity[product] : 0;
+    }
+
+    // Число записей в списке чеков товара
+    size_t receiptCountOf(uint32_t product) const {
+        return product < productReceipts.size() ? productReceipts[product].size() : 0;
+    }
+};
+
+// Исходная схема одновременного обновления для сравнения: общие массивы под одним
+// std::mutex, который берётся на каждую позицию (как в первоначальном
+// SalesProcessor::processReceipt). Запросы и вывод отчёта ждут тот же мьютекс
+class GlobalMutexAggregator {
+public:
+    explicit GlobalMutexAggregator(const ProductDictionary& dict)
+        : dictionary(dict), quantities(dict.size()), receipts(dict.size()) {}
+
+    void processReceipt(ReceiptView receipt) {
+        for (size_t i = 0; i < receipt.size(); ++i) {
+            uint32_t product = receipt.productId[i];
+            std::lock_guard<std::mutex> lock(mtx); // Блокируем доступ для синхронизации
+            quantities[product] += receipt.quantity[i];
+            receipts[product].push_back({receipt.receiptId[i], receipt.price[i]});
+        }
+    }
+
+    void processAll(ReceiptView items, ThreadPool& pool, size_t grain = 16384) {
+        forEachReceiptParallel(items, pool, grain, [&](ReceiptView receipt) { processReceipt(receipt); });
+    }
+
+    long long quantityOf(uint32_t product) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return quantities[product];
+    }
+
+    std::vector<ReceiptRef> receiptsOf(uint32_t product) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return receipts[product];
+    }
+
+    // Вывод отчёта: загрузка стоит всё время форматирования
+    PrintStats printResults(OutputSink& sink, ThreadPool& pool, OutputMode mode = OutputMode::Full) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return writeProductReport(sink, pool, mode, dictionary.size(),
+            [&](uint32_t product) -> const std::string& { return dictionary.name(product); },
+            [&](uint32_t product) { return quantities[product]; },
+            [&](uint32_t product) { return std::span<const ReceiptRef>(receipts[product]); });
+    }
+
+private:
+    const ProductDictionary& dictionary;
+    std::vector<long long> quantities;
+    std::vector<std::vector<ReceiptRef>> receipts;
+    mutable std::mutex mtx;
+};
+
+// Общий агрегатор для одновременного обновления несколькими потоками-производителями.
+// Товары распределены по шардам (номер товара по модулю числа шардов), у каждого шарда
+// свой std::shared_mutex: запись блокирует только свой шард, а запросы (итоги по товару,
+// вывод отчёта) берут разделяемую блокировку и работают параллельно с загрузкой
+class ShardedSalesAggregator {
+public:
+    ShardedSalesAggregator(const ProductDictionary& dict, size_t numShards)
+        : dictionary(dict), shards(std::max<size_t>(numShards, 1)) {
+        for (auto& shard : shards) {
+            shard = std::make_unique<Shard>();
+        }
+    }
+
+    size_t shardCount() const { return shards.size(); }
+
+    // Обработка одного чека: каждая позиция блокирует шард своего товара
+    void processReceipt(ReceiptView receipt) {
+        for (size_t i = 0; i < receipt.size(); ++i) {
+            uint32_t product = receipt.productId[i];
+            Shard& shard = *shards[product % shards.size()];
+            std::unique_lock<std::shared_mutex> lock(shard.mtx);
+            Entry& entry = shard.entry(product / shards.size());
+            entry.quantity += receipt.quantity[i];
+            entry.receipts.push_back({receipt.receiptId[i], receipt.price[i]});
+        }
+    }
+
+    void processAll(ReceiptView items, ThreadPool& pool, size_t grain = 16384) {
+        forEachReceiptParallel(items, pool, grain, [&](ReceiptView receipt) { processReceipt(receipt); });
+    }
+
+    // Итог по товару; не мешает другим читателям и блокирует запись только в шард товара
+    long long quantityOf(uint32_t product) const {
+        const Shard& shard = *shards[product % shards.size()];
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        size_t index = product / shards.size();
+        return index < shard.entries.size() ? shard.entries[index].quantity : 0;
+    }
+
+    // Число записей в списке чеков товара
+    size_t receiptCountOf(uint32_t product) const {
+        const Shard& shard = *shards[product % shards.size()];
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        size_t index = product / shards.size();
+        return index < shard.entries.size() ? shard.entries[index].receipts.size() : 0;
+    }
+
+    // Копия списка чеков товара
+    std::vector<ReceiptRef> receiptsOf(uint32_t product) const {
+        const Shard& shard = *shards[product % shards.size()];
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        size_t index = product / shards.size();
+        return index < shard.entries.size() ? shard.entries[index].receipts : std::vector<ReceiptRef>();
+    }
+
+    // Вывод отчёта по согласованному снимку: на время форматирования все шарды
+    // блокируются на чтение, загрузка в них ждёт только это время
+    PrintStats printResults(OutputSink& sink, ThreadPool& pool, OutputMode mode = OutputMode::Full) const {
+        std::vector<std::shared_lock<std::shared_mutex>> locks;
+        for (const auto& shard : shards) {
+            locks.emplace_back(shard->mtx);
+        }
+        static const std::vector<ReceiptRef> none;
+        auto entryOf = [&](uint32_t product) -> const Entry* {
+            const Shard& shard = *shards[product % shards.size()];
+            size_t index = product / shards.size();
+            return index < shard.entries.size() ? &shard.entries[index] : nullptr;
+        };
+        return writeProductReport(sink, pool, mode, dictionary.size(),
+            [&](uint32_t product) -> const std::string& { return dictionary.name(product); },
+            [&](uint32_t product) { const Entry* e = entryOf(product); return e ? e->quantity : 0LL; },
+            [&](uint32_t product) { const Entry* e = entryOf(product); return std::span<const ReceiptRef>(e ? e->receipts : none); });
+    }
+
+private:
+    // Данные одного товара
+    struct Entry {
+        long long quantity = 0;
+        std::vector<ReceiptRef> receipts;
+    };
+
+    // Шард: товары с номерами shard, shard + N, shard + 2N, ... (выравнивание исключает ложное разделение)
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mtx;
+        std::vector<Entry> entries;
+
+        Entry& entry(size_t index) {
+            if (index >= entries.size()) {
+                entries.resize(index + 1); // новый товар
+            }
+            return entries[index];
+        }
+    };
+
+    const ProductDictionary& dictionary;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
+
+// Сводные показатели по товару: количество, выручка (цена × количество, в копейках),
+// число позиций и наименьшая/наибольшая цена
+struct ProductTotals {
+    long long quantity = 0;
+    long long revenue = 0;
+    long long count = 0;
+    int32_t minPrice = INT32_MAX;
+    int32_t maxPrice = INT32_MIN;
+
+    void merge(const ProductTotals& other) {
+        quantity += other.quantity;
+        revenue += other.revenue;
+        count += other.count;
+        minPrice = std::min(minPrice, other.minPrice);
+        maxPrice = std::max(maxPrice, other.maxPrice);
+    }
+
+    // Средняя цена единицы товара в копейках (с учётом количества)
+    double averagePrice() const { return quantity != 0 ? static_cast<double>(revenue) / quantity : 0; }
+};
+
+// Аккумулятор ядра агрегации занимает ровно 32 байта, чтобы обновляться одной AVX2-операцией:
+// три 64-битных суммы складываются, а пара (цена, ~цена) сводится минимумом, так что
+// ~notMaxPrice — наибольшая цена. Начальное значение INT32_MAX подходит для обеих половин пары
+struct alignas(32) TotalsAccumulator {
+    int64_t quantity = 0;
+    int64_t revenue = 0;
+    int64_t count = 0;
+    int32_t minPrice = INT32_MAX;
+    int32_t notMaxPrice = INT32_MAX;
+};
+
+// Соседние позиции пишут в разные банки аккумуляторов: повторы одного товара подряд
+// не ждут завершения предыдущей записи в ту же память
+constexpr size_t totalsBanks = 4;
+
+// Свёртка банков в итоговые показатели (добавляются к totals)
+void mergeTotalsBanks(const std::vector<TotalsAccumulator>& banks, std::vector<ProductTotals>& totals) {
+    for (size_t product = 0; product < totals.size(); ++product) {
+        for (size_t bank = 0; bank < totalsBanks; ++bank) {
+            const TotalsAccumulator& acc = banks[product * totalsBanks + bank];
+            totals[product].merge({acc.quantity, acc.revenue, acc.count, acc.minPrice, ~acc.notMaxPrice});
+        }
+    }
+}
+
+// Скалярное ядро: один проход по столбцам товаров, цен и количеств
+void aggregateColumnsScalar(ReceiptView items, std::vector<TotalsAccumulator>& banks) {
+    for (size_t i = 0; i < items.size(); ++i) {
+        TotalsAccumulator& acc = banks[items.productId[i] * totalsBanks + (i & (totalsBanks - 1))];
+        int32_t price = items.price[i];
+        acc.quantity += items.quantity[i];
+        acc.revenue += static_cast<int64_t>(price) * items.quantity[i];
+        acc.count += 1;
+        acc.minPrice = std::min(acc.minPrice, price);
+        acc.notMaxPrice = std::min(acc.notMaxPrice, ~price);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Применение вектора одной позиции к аккумулятору её товара
+__attribute__((target("avx2"), always_inline))
+inline void applyTotalsAvx2(__m256i* acc, uint32_t product, size_t bank, __m256i item) {
+    __m256i* slot = acc + product * totalsBanks + bank;
+    __m256i current = _mm256_load_si256(slot);
+    __m256i sums = _mm256_add_epi64(current, item);
+    __m256i prices = _mm256_min_epi32(current, item);
+    _mm256_store_si256(slot, _mm256_blend_epi32(sums, prices, 0xC0)); // старшие 32-битные половины — пара цен
+}
+
+// AVX2-ядро: по четыре позиции за шаг. Количества и цены расширяются до 64 бит, выручка
+// считается одним _mm256_mul_epi32, затем строки (количество, выручка, 1, пара цен)
+// транспонируются в четыре 32-байтных вектора — по одному на позицию — и каждый
+// применяется к аккумулятору товара сложением, минимумом и смешиванием
+__attribute__((target("avx2")))
+void aggregateColumnsAvx2(ReceiptView items, std::vector<TotalsAccumulator>& banks) {
+    static_assert(sizeof(TotalsAccumulator) == 32 && totalsBanks == 4);
+    __m256i* acc = reinterpret_cast<__m256i*>(banks.data());
+    const __m256i ones = _mm256_set1_epi64x(1);
+    const __m128i allBits = _mm_set1_epi32(-1);
+
+    size_t n = items.size();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i price = _mm_loadu_si128(reinterpret_cast<const __m128i*>(items.price.data() + i));
+        __m128i quantity = _mm_loadu_si128(reinterpret_cast<const __m128i*>(items.quantity.data() + i));
+        __m256i quantity64 = _mm256_cvtepi32_epi64(quantity);
+        __m256i revenue = _mm256_mul_epi32(_mm256_cvtepi32_epi64(price), quantity64);
+        __m128i notPrice = _mm_xor_si128(price, allBits);
+        __m256i pricePairs = _mm256_set_m128i(_mm_unpackhi_epi32(price, notPrice), _mm_unpacklo_epi32(price, notPrice));
+
+        __m256i t0 = _mm256_unpacklo_epi64(quantity64, revenue); // q0 r0 q2 r2
+        __m256i t1 = _mm256_unpackhi_epi64(quantity64, revenue); // q1 r1 q3 r3
+        __m256i t2 = _mm256_unpacklo_epi64(ones, pricePairs);    // 1 p0 1 p2
+        __m256i t3 = _mm256_unpackhi_epi64(ones, pricePairs);    // 1 p1 1 p3
+        applyTotalsAvx2(acc, items.productId[i], 0, _mm256_permute2x128_si256(t0, t2, 0x20));
+        applyTotalsAvx2(acc, items.productId[i + 1], 1, _mm256_permute2x128_si256(t1, t3, 0x20));
+        applyTotalsAvx2(acc, items.productId[i + 2], 2, _mm256_permute2x128_si256(t0, t2, 0x31));
+        applyTotalsAvx2(acc, items.productId[i + 3], 3, _mm256_permute2x128_si256(t1, t3, 0x31));
+    }
+    aggregateColumnsScalar(items.slice(i, n), banks); // хвост короче четырёх позиций
+}
+#endif
+
+// Выбор ядра при запуске по возможностям процессора
+enum class TotalsKernel { Scalar, Avx2 };
+
+TotalsKernel bestTotalsKernel() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2) {
+        return TotalsKernel::Avx2;
+    }
+#endif
+    return TotalsKernel::Scalar;
+}
+
+const char* totalsKernelName(TotalsKernel kernel) {
+    return kernel == TotalsKernel::Avx2 ? "AVX2" : "скалярное";
+}
+
+// Сводные показатели по всем товарам за один проход по столбцам. Каждый поток пула
+// сводит свои диапазоны в собственные банки аккумуляторов, затем банки складываются
+std::vector<ProductTotals> aggregateColumns(ReceiptView items, size_t numProducts, ThreadPool& pool, TotalsKernel kernel = bestTotalsKernel()) {
+    std::vector<std::vector<TotalsAccumulator>> local(pool.size());
+    pool.parallelFor(items.size(), 1 << 16, [&](size_t begin, size_t end, int worker) {
+        auto& banks = local[worker];
+        if (banks.empty()) {
+            banks.resize(numProducts * totalsBanks); // первое касание — в своём потоке
+        }
+        ReceiptView range = items.slice(begin, end);
+#if defined(__x86_64__) || defined(__i386__)
+        if (kernel == TotalsKernel::Avx2) {
+            aggregateColumnsAvx2(range, banks);
+            return;
+        }
+#endif
+        aggregateColumnsScalar(range, banks);
+    });
+
+    std::vector<ProductTotals> totals(numProducts);
+    for (const auto& banks : local) {
+        if (!banks.empty()) {
+            mergeTotalsBanks(banks, totals);
+        }
+    }
+    return totals;
+}
+
+// Таблица сводных показателей: товар, позиции, количество, выручка, цены
+PrintStats writeTotalsReport(OutputSink& sink, const ProductDictionary& dictionary, const std::vector<ProductTotals>& totals) {
+    PrintStats stats;
+    auto start = std::chrono::high_resolution_clock::now();
+    OutputBuffer out;
+    for (uint32_t product = 0; product < totals.size(); ++product) {
+        const ProductTotals& t = totals[product];
+        if (t.count == 0) {
+            continue;
+        }
+        out.append("Товар: ");
+        out.append(dictionary.name(product));
+        out.append(", позиций: ");
+        out.appendNumber(t.count);
+        out.append(", количество: ");
+        out.appendNumber(t.quantity);
+        out.append(", выручка: ");
+        out.appendPrice(t.revenue);
+        out.append(", цена: от ");
+        out.appendPrice(t.minPrice);
+        out.append(" до ");
+        out.appendPrice(t.maxPrice);
+        out.append(", средняя ");
+        out.appendPrice(std::llround(t.averagePrice()));
+        out.append("\n");
+    }
+    auto formatted = std::chrono::high_resolution_clock::now();
+    sink.write({out.view()});
+    auto written = std::chrono::high_resolution_clock::now();
+    stats.formatSeconds = std::chrono::duration<double>(formatted - start).count();
+    stats.ioSeconds = std::chrono::duration<double>(written - formatted).count();
+    stats.bytes = out.size();
+    return stats;
+}
+
+// Числа переменной длины (LEB128): по 7 бит в байте, старший бит — признак продолжения
+inline void appendVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline uint32_t readVarint(const uint8_t*& p) {
+    uint32_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = *p++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+// Список чеков одного товара (posting list), упорядоченный по номеру чека.
+// Номера чеков хранятся разностями в LEB128 (обычно 1–2 байта на запись), цены — отдельным
+// столбцом кодов из словаря цен товара (у товара обычно одна-две цены, код занимает байт).
+// Каждые skipInterval записей запоминается точка входа, по которой пересечение
+// перепрыгивает заведомо меньшие номера без декодирования
+struct PostingList {
+    static constexpr size_t skipInterval = 128;
+
+    // Точка входа перед записью (j + 1) * skipInterval
+    struct Skip {
+        int32_t previousId;       // Номер чека предыдущей записи (база для разности)
+        uint32_t receiptOffset;   // Смещение в receipts
+        uint32_t priceOffset;     // Смещение в priceCodes
+    };
+
+    std::vector<uint8_t> receipts;   // Разности номеров чеков
+    std::vector<uint8_t> priceCodes; // Коды цен
+    std::vector<int32_t> prices;     // Словарь цен товара (код -> цена в копейках)
+    std::vector<Skip> skips;
+    size_t count = 0;
+
+    size_t memoryBytes() const {
+        return receipts.capacity() + priceCodes.capacity() + prices.capacity() * sizeof(int32_t) + skips.capacity() * sizeof(Skip);
+    }
+
+    // Последовательное чтение списка с переходом к первому номеру не меньше заданного
+    class Cursor {
+    public:
+        explicit Cursor(const PostingList& postings)
+            : list(&postings), receiptPos(postings.receipts.data()), pricePos(postings.priceCodes.data()) {}
+
+        // Следующая запись; false, если список закончился
+        bool next() {
+            if (index == list->count) {
+                return false;
+            }
+            current = static_cast<int32_t>(static_cast<uint32_t>(current) + readVarint(receiptPos));
+            price = list->prices[readVarint(pricePos)];
+            ++index;
+            return true;
+        }
+
+        // Переход к первой записи с номером чека не меньше target (текущая запись тоже подходит)
+        bool advanceTo(int32_t target) {
+            if (index > 0 && current >= target) {
+                return true;
+            }
+            // Последняя точка входа впереди курсора, перед которой все номера меньше target
+            size_t first = index / skipInterval; // точки с меньшим номером уже пройдены
+            auto begin = list->skips.begin() + std::min(first, list->skips.size());
+            auto it = std::partition_point(begin, list->skips.end(), [&](const Skip& s) { return s.previousId < target; });
+            if (it != begin) {
+                const Skip& skip = *(it - 1);
+                size_t skipIndex = (static_cast<size_t>(it - 1 - list->skips.begin()) + 1) * skipInterval;
+                if (skipIndex > index) {
+                    index = skipIndex;
+                    current = skip.previousId;
+                    receiptPos = list->receipts.data() + skip.receiptOffset;
+                    pricePos = list->priceCodes.data() + skip.priceOffset;
+                }
+            }
+            while (next()) {
+                if (current >= target) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        int32_t receiptId() const { return current; }
+        int32_t priceKopecks() const { return price; }
+
+    private:
+        const PostingList* list;
+        const uint8_t* receiptPos;
+        const uint8_t* pricePos;
+        size_t index = 0;     // Сколько записей прочитано
+        int32_t current = 0;  // Номер чека последней прочитанной записи
+        int32_t price = 0;
+    };
+};
+
+// Пополнение списка чеков товара. Записи должны поступать по неубыванию номера чека,
+// иначе sorted сбрасывается и список нужно перестроить
+class PostingBuilder {
+public:
+    void add(int32_t receiptId, int32_t price) {
+        if (postings.count > 0 && receiptId < last) {
+            sorted = false;
+        }
+        if (postings.count > 0 && postings.count % PostingList::skipInterval == 0) {
+            postings.skips.push_back({last, static_cast<uint32_t>(postings.receipts.size()), static_cast<uint32_t>(postings.priceCodes.size())});
+        }
+        appendVarint(postings.receipts, static_cast<uint32_t>(receiptId) - static_cast<uint32_t>(last));
+        appendVarint(postings.priceCodes, priceCode(price));
+        last = receiptId;
+        ++postings.count;
+    }
+
+    bool isSorted() const { return sorted; }
+    int32_t lastId() const { return last; }
+    const PostingList& list() const { return postings; }
+
+    PostingList finish() {
+        postings.receipts.shrink_to_fit();
+        postings.priceCodes.shrink_to_fit();
+        postings.prices.shrink_to_fit();
+        postings.skips.shrink_to_fit();
+        return std::move(postings);
+    }
+
+private:
+    uint32_t priceCode(int32_t price) {
+        if (lastCode < postings.prices.size() && postings.prices[lastCode] == price) {
+            return lastCode; // подряд обычно идёт одна и та же цена
+        }
+        auto [it, inserted] = codes.try_emplace(price, static_cast<uint32_t>(postings.prices.size()));
+        if (inserted) {
+            postings.prices.push_back(price);
+        }
+        lastCode = it->second;
+        return lastCode;
+    }
+
+    PostingList postings;
+    std::unordered_map<int32_t, uint32_t> codes;
+    uint32_t lastCode = 0;
+    int32_t last = 0;
+    bool sorted = true;
+};
+
+// Сумма чека
+struct ReceiptSpend {
+    int32_t receiptId;
+    long long spend; // В копейках
+};
+
+// Обратный индекс «товар -> чеки» по столбцам позиций. Строится параллельно: позиции
+// делятся на сегменты по границам чеков, каждый сегмент кодирует свои списки, затем
+// списки каждого товара склеиваются по порядку сегментов. Попутно для каждого сегмента
+// отбираются самые дорогие чеки, так что top-N не требует повторного просмотра позиций
+class ReceiptIndex {
+public:
+    ReceiptIndex(ReceiptView items, size_t numProducts, ThreadPool& pool, size_t topCapacity = 1000)
+        : postings(numProducts), topCapacity(topCapacity) {
+        size_t numSegments = std::max<size_t>(1, std::min(items.size() / 4096 + 1, static_cast<size_t>(pool.size()) * 4));
+        std::vector<size_t> bounds(numSegments + 1);
+        for (size_t s = 0; s <= numSegments; ++s) {
+            bounds[s] = receiptBoundary(items, items.size() * s / numSegments);
+        }
+
+        std::vector<std::vector<PostingBuilder>> segments(numSegments);
+        std::vector<std::vector<ReceiptSpend>> segmentTop(numSegments);
+        pool.parallelFor(numSegments, 1, [&](size_t begin, size_t end, int) {
+            for (size_t s = begin; s < end; ++s) {
+                segments[s].resize(numProducts);
+                buildSegment(items.slice(bounds[s], bounds[s + 1]), segments[s], segmentTop[s]);
+            }
+        });
+
+        pool.parallelFor(numProducts, 1, [&](size_t begin, size_t end, int) {
+            for (size_t product = begin; product < end; ++product) {
+                postings[product] = mergeSegments(segments, product);
+            }
+        });
+
+        for (auto& top : segmentTop) {
+            topReceipts.insert(topReceipts.end(), top.begin(), top.end());
+        }
+        std::sort(topReceipts.begin(), topReceipts.end(), spendsMore);
+        if (topReceipts.size() > topCapacity) {
+            topReceipts.resize(topCapacity);
+        }
+        topReceipts.shrink_to_fit();
+    }
+
+    size_t productCount() const { return postings.size(); }
+
+    size_t receiptCount(uint32_t product) const {
+        return product < postings.size() ? postings[product].count : 0;
+    }
+
+    // Чеки, содержащие товар (с ценой товара в чеке), по возрастанию номера
+    std::vector<ReceiptRef> receiptsWith(uint32_t product) const {
+        std::vector<ReceiptRef> result;
+        if (product >= postings.size()) {
+            return result;
+        }
+        result.reserve(postings[product].count);
+        PostingList::Cursor cursor(postings[product]);
+        while (cursor.next()) {
+            result.push_back({cursor.receiptId(), cursor.priceKopecks()});
+        }
+        return result;
+    }
+
+    // Номера чеков, содержащих оба товара: короткий список перебирается,
+    // а по длинному курсор перепрыгивает через точки входа
+    std::vector<int32_t> receiptsWithBoth(uint32_t a, uint32_t b) const {
+        std::vector<int32_t> result;
+        if (a >= postings.size() || b >= postings.size()) {
+            return result;
+        }
+        const PostingList* shorter = &postings[a];
+        const PostingList* longer = &postings[b];
+        if (shorter->count > longer->count) {
+            std::swap(shorter, longer);
+        }
+        PostingList::Cursor small(*shorter);
+        PostingList::Cursor large(*longer);
+        while (small.next()) {
+            int32_t id = small.receiptId();
+            if (!result.empty() && result.back() == id) {
+                continue; // товар встретился в чеке несколько раз
+            }
+            if (!large.advanceTo(id)) {
+                break;
+            }
+            if (large.receiptId() == id) {
+                result.push_back(id);
+            }
+        }
+        return result;
+    }
+
+    // Самые дорогие чеки (не больше topCapacity, заданного при построении)
+    std::vector<ReceiptSpend> topReceiptsBySpend(size_t n) const {
+        return {topReceipts.begin(), topReceipts.begin() + std::min(n, topReceipts.size())};
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = postings.capacity() * sizeof(PostingList) + topReceipts.capacity() * sizeof(ReceiptSpend);
+        for (const auto& list : postings) {
+            bytes += list.memoryBytes();
+        }
+        return bytes;
+    }
+
+private:
+    static bool spendsMore(const ReceiptSpend& a, const ReceiptSpend& b) {
+        return a.spend != b.spend ? a.spend > b.spend : a.receiptId < b.receiptId;
+    }
+
+    void buildSegment(ReceiptView range, std::vector<PostingBuilder>& builders, std::vector<ReceiptSpend>& top) const {
+        // Отбор самых дорогих чеков сегмента: куча с самым дешёвым из отобранных на вершине
+        auto add = [&](int32_t receiptId, long long spend) {
+            if (top.size() < topCapacity) {
+                top.push_back({receiptId, spend});
+                std::push_heap(top.begin(), top.end(), spendsMore);
+            } else if (topCapacity > 0 && spendsMore({receiptId, spend}, top.front())) {
+                std::pop_heap(top.begin(), top.end(), spendsMore);
+                top.back() = {receiptId, spend};
+                std::push_heap(top.begin(), top.end(), spendsMore);
+            }
+        };
+
+        long long spend = 0;
+        for (size_t i = 0; i < range.size(); ++i) {
+            builders[range.productId[i]].add(range.receiptId[i], range.price[i]);
+            spend += static_cast<long long>(range.price[i]) * range.quantity[i];
+            if (i + 1 == range.size() || range.receiptId[i + 1] != range.receiptId[i]) {
+                add(range.receiptId[i], spend);
+                spend = 0;
+            }
+        }
+    }
+
+    // Склейка списков товара из всех сегментов. Записи перекодируются в общий словарь цен;
+    // если номера чеков в файле шли не по порядку, список сортируется (устойчиво)
+    static PostingList mergeSegments(std::vector<std::vector<PostingBuilder>>& segments, size_t product) {
+        bool sorted = true;
+        bool started = false;
+        int32_t last = 0;
+        for (const auto& segment : segments) {
+            const PostingBuilder& builder = segment[product];
+            if (builder.list().count == 0) {
+                continue;
+            }
+            PostingList::Cursor cursor(builder.list());
+            cursor.next();
+            sorted = sorted && builder.isSorted() && (!started || cursor.receiptId() >= last);
+            last = builder.lastId();
+            started = true;
+        }
+
+        std::vector<ReceiptRef> unsortedEntries;
+        PostingBuilder merged;
+        for (auto& segment : segments) {
+            PostingBuilder& builder = segment[product];
+            PostingList::Cursor cursor(builder.list());
+            while (cursor.next()) {
+                if (sorted) {
+                    merged.add(cursor.receiptId(), cursor.priceKopecks());
+                } else {
+                    unsortedEntries.push_back({cursor.receiptId(), cursor.priceKopecks()});
+                }
+            }
+            builder = PostingBuilder(); // память сегмента больше не нужна
+        }
+        if (!sorted) {
+            std::stable_sort(unsortedEntries.begin(), unsortedEntries.end(), [](const ReceiptRef& a, const ReceiptRef& b) {
+                return a.receiptId < b.receiptId;
+            });
+            for (const ReceiptRef& entry : unsortedEntries) {
+                merged.add(entry.receiptId, entry.price);
+            }
+        }
+        return merged.finish();
+    }
+
+    std::vector<PostingList> postings; // По номеру товара
+    std::vector<ReceiptSpend> topReceipts; // По убыванию суммы
+    size_t topCapacity;
+};
+
+// Файл, отображённый в память только для чтения (освобождается в деструкторе)
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename) {
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Не удалось открыть файл: " << filename << "\n";
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            return; // пустой файл отображать не нужно
+        }
+        length = static_cast<size_t>(st.st_size);
+        void* addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            std::cerr << "Не удалось отобразить файл в память: " << filename << "\n";
+            length = 0;
+            return;
+        }
+        ::madvise(addr, length, MADV_WILLNEED); // просим ядро заранее подгрузить страницы
+        begin = static_cast<const char*>(addr);
+    }
+
+    ~MappedFile() {
+        if (begin) {
+            ::munmap(const_cast<char*>(begin), length);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return begin; }
+    size_t size() const { return length; }
+
+private:
+    int fd = -1;                 // Дескриптор файла
+    const char* begin = nullptr; // Начало отображения
+    size_t length = 0;           // Размер файла в байтах
+};
+
+// Статистика загрузки файла с чеками
+struct LoadStats {
+    size_t bytes = 0;    // Размер разобранного файла
+    size_t receipts = 0; // Количество чеков (различных номеров: строки с одним номером — один чек)
+    size_t items = 0;    // Количество позиций во всех чеках
+    size_t errors = 0;   // Количество пропущенных строк
+    double seconds = 0;  // Время загрузки
+    bool failed = false; // Файл не удалось открыть или прочитать
+
+    void print() const {
+        double mb = bytes / (1024.0 * 1024.0);
+        std::cout << "Загружено чеков: " << receipts << " (позиций: " << items << ", ошибок: " << errors << ")"
+                  << ", " << mb << " МБ за " << seconds << " секунд"
+                  << " — " << (seconds > 0 ? mb / seconds : 0) << " МБ/с, "
+                  << (seconds > 0 ? receipts / seconds : 0) << " чеков/с\n";
+    }
+};
+
+// Пропуск пробелов внутри строки (перевод строки не пропускается)
+inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        ++p;
+    }
+    return p;
+}
+
+// Разбор неотрицательного целого числа; возвращает nullptr, если цифр нет
+// или число не помещается в int
+inline const char* parseInt(const char* p, const char* end, int& value) {
+    const char* start = p;
+    int result = 0;
+    while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+        int digit = *p - '0';
+        if (result > (INT_MAX - digit) / 10) {
+            return nullptr;
+        }
+        result = result * 10 + digit;
+        ++p;
+    }
+    if (p == start) {
+        return nullptr;
+    }
+    value = result;
+    return p;
+}
+
+// Разбор цены вида "1.5" или "3" сразу в копейки; возвращает nullptr, если цифр нет
+// или цена в копейках не помещается в int32_t
+inline const char* parsePrice(const char* p, const char* end, int32_t& kopecks) {
+    int whole = 0;
+    p = parseInt(p, end, whole);
+    if (!p || whole > (INT32_MAX - 100) / 100) { // 100 — наибольшая добавка копеек с округлением
+        return nullptr;
+    }
+    int32_t result = whole * 100;
+    if (p < end && *p == '.') {
+        ++p;
+        int digits = 0;
+        while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+            if (digits == 0) {
+                result += (*p - '0') * 10;
+            } else if (digits == 1) {
+                result += *p - '0';
+            } else if (digits == 2 && *p >= '5') {
+                result += 1; // округляем до копейки
+            }
+            ++digits;
+            ++p;
+        }
+    }
+    kopecks = result;
+    return p;
+}
+
+// Разбор одной строки "id товар цена количество, товар цена количество, ...".
+// Для каждой позиции вызывается onItem(id, название, цена в копейках, количество).
+// Возвращает false, если строка повреждена
+template <typename OnItem>
+inline bool parseReceiptLine(const char* p, const char* end, OnItem&& onItem) {
+    int id = 0;
+    p = parseInt(skipSpaces(p, end), end, id);
+    if (!p) {
+        return false;
+    }
+
+    while (true) {
+        p = skipSpaces(p, end);
+        const char* nameBegin = p;
+        while (p < end && *p != ' ' && *p != '\t') {
+            ++p;
+        }
+        if (p == nameBegin) {
+            return false; // после id или запятой должен идти товар
+        }
+        std::string_view name(nameBegin, p - nameBegin);
+
+        int32_t price = 0;
+        int quantity = 0;
+        p = parsePrice(skipSpaces(p, end), end, price);
+        if (!p) {
+            return false;
+        }
+        p = parseInt(skipSpaces(p, end), end, quantity);
+        if (!p) {
+            return false;
+        }
+        onItem(id, name, price, quantity);
+
+        p = skipSpaces(p, end);
+        if (p == end) {
+            return true;
+        }
+        if (*p != ',') {
+            return false;
+        }
+        ++p;
+    }
+}
+
+// Разбор строки [p, lineEnd) в конец columns; названия товаров заносятся в dictionary.
+// Повреждённая строка откатывается, и возвращается false
+inline bool parseLine(const char* p, const char* lineEnd, ReceiptColumns& columns, ProductDictionary& dictionary) {
+    size_t itemsBefore = columns.size();
+    bool ok = parseReceiptLine(p, lineEnd, [&](int id, std::string_view name, int32_t price, int quantity) {
+        columns.push(id, dictionary.intern(name), price, quantity);
+    });
+    if (ok) {
+        ++columns.receiptCount;
+    } else {
+        columns.resize(itemsBefore); // откатываем частично разобранную строку
+    }
+    return ok;
+}
+
+// Результат разбора одного фрагмента файла
+struct ChunkResult {
+    ReceiptColumns columns;         // Позиции с номерами товаров из локального словаря
+    ProductDictionary dictionary;   // Локальный словарь фрагмента
+    std::vector<std::string> badLines; // Первые повреждённые строки (для сообщения об ошибке)
+    size_t errors = 0;
+
+    void addError(const char* line, const char* lineEnd) {
+        if (badLines.size() < 10) {
+            badLines.emplace_back(line, lineEnd);
+        }
+        ++errors;
+    }
 };
 
-// Структура, описывающая чек
-struct Receipt {
-    int id;                    // Уникальный идентификатор чека
-    std::vector<Product> products; // Список товаров в чеке
+// Разбор фрагмента [begin, end), границы которого совпадают с началами строк
+void parseChunk(const char* begin, const char* end, ChunkResult& result) {
+    const char* p = begin;
+    while (p < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        if (skipSpaces(p, lineEnd) != lineEnd && !parseLine(p, lineEnd, result.columns, result.dictionary)) { // пустые строки пропускаем
+            result.addError(p, lineEnd);
+        }
+        p = lineEnd + 1;
+    }
+}
+
+// Устойчивая параллельная сортировка позиций по номеру чека — для данных, где упорядоченных
+// серий слишком много для слияния. Ключ — номер чека в старших 32 битах и номер позиции
+// в младших, поэтому ключи различны и порядок равных номеров сохраняется без устойчивой
+// сортировки. Блоки ключей сортируются параллельно, затем сливаются попарно по уровням
+ReceiptColumns sortByReceiptId(ReceiptView items, ThreadPool& pool) {
+    size_t count = items.size();
+    std::vector<uint64_t> keys(count);
+    std::vector<uint64_t> buffer(count);
+    size_t numBlocks = static_cast<size_t>(pool.size());
+    size_t block = (count + numBlocks - 1) / numBlocks;
+    pool.parallelFor(numBlocks, 1, [&](size_t begin, size_t end, int) {
+        ScopedPhase phase("сортировка по номерам чеков");
+        for (size_t b = begin; b < end; ++b) {
+            size_t from = std::min(count, b * block);
+            size_t to = std::min(count, from + block);
+            for (size_t i = from; i < to; ++i) {
+                // Сдвиг знакового номера в беззнаковый диапазон сохраняет порядок
+                uint64_t id = static_cast<uint32_t>(items.receiptId[i]) ^ 0x80000000u;
+                keys[i] = id << 32 | i;
+            }
+            std::sort(keys.begin() + from, keys.begin() + to);
+        }
+    });
+    for (size_t width = block; width < count; width *= 2) {
+        size_t pairs = (count + 2 * width - 1) / (2 * width);
+        pool.parallelFor(pairs, 1, [&](size_t begin, size_t end, int) {
+            ScopedPhase phase("сортировка по номерам чеков");
+            for (size_t pair = begin; pair < end; ++pair) {
+                size_t from = pair * 2 * width;
+                size_t middle = std::min(count, from + width);
+                size_t to = std::min(count, from + 2 * width);
+                std::merge(keys.begin() + from, keys.begin() + middle, keys.begin() + middle, keys.begin() + to, buffer.begin() + from);
+            }
+        });
+        keys.swap(buffer);
+    }
+
+    ReceiptColumns sorted;
+    sorted.resize(count);
+    pool.parallelFor(count, 1 << 16, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            size_t from = static_cast<uint32_t>(keys[i]);
+            sorted.receiptId[i] = items.receiptId[from];
+            sorted.productId[i] = items.productId[from];
+            sorted.price[i] = items.price[from];
+            sorted.quantity[i] = items.quantity[from];
+        }
+    });
+    return sorted;
+}
+
+// Слияние позиций по номерам чеков. Позиции делятся на серии — наибольшие участки, где номера
+// чеков не убывают (упорядоченный файл — одна серия). Серии сливаются устойчиво: при равных
+// номерах первой идёт серия, которая раньше во входных данных, поэтому результат не зависит
+// от числа потоков. Диапазон номеров делится на части, границы части в каждой серии находятся
+// двоичным поиском, и каждая часть сливается отдельной задачей пула. Таблица границ занимает
+// части × серии, поэтому при сериях больше, чем частей (например, перемешанный файл),
+// позиции вместо слияния сортируются (см. sortByReceiptId) — результат тот же
+ReceiptColumns mergeByReceiptId(ReceiptView items, ThreadPool& pool) {
+    size_t numParts = static_cast<size_t>(pool.size()) * 4;
+    std::vector<size_t> runs{0}; // Начала серий и конец последней
+    for (size_t i = 1; i < items.size(); ++i) {
+        if (items.receiptId[i] < items.receiptId[i - 1]) {
+            runs.push_back(i);
+            if (runs.size() > numParts && items.size() <= UINT32_MAX) { // номер позиции должен уместиться в ключ
+                return sortByReceiptId(items, pool);
+            }
+        }
+    }
+    runs.push_back(items.size());
+    size_t numRuns = runs.size() - 1;
+
+    auto [minId, maxId] = std::minmax_element(items.receiptId.begin(), items.receiptId.end());
+    long long span = static_cast<long long>(*maxId) - *minId + 1;
+    // bounds[part * numRuns + run] — первая позиция серии run с номером чека из части part или дальше
+    std::vector<size_t> bounds((numParts + 1) * numRuns);
+    for (size_t part = 0; part <= numParts; ++part) {
+        long long lowest = *minId + span * static_cast<long long>(part) / static_cast<long long>(numParts);
+        for (size_t run = 0; run < numRuns; ++run) {
+            auto begin = items.receiptId.begin() + runs[run];
+            auto end = items.receiptId.begin() + runs[run + 1];
+            bounds[part * numRuns + run] = part == numParts ? runs[run + 1] : std::lower_bound(begin, end, lowest) - items.receiptId.begin();
+        }
+    }
+    std::vector<size_t> offsets(numParts + 1, 0);
+    for (size_t part = 0; part < numParts; ++part) {
+        offsets[part + 1] = offsets[part];
+        for (size_t run = 0; run < numRuns; ++run) {
+            offsets[part + 1] += bounds[(part + 1) * numRuns + run] - bounds[part * numRuns + run];
+        }
+    }
+
+    ReceiptColumns merged;
+    merged.resize(items.size());
+    pool.parallelFor(numParts, 1, [&](size_t begin, size_t end, int) {
+        ScopedPhase phase("слияние по номерам чеков");
+        // Куча из (номер чека, серия, позиция) с наименьшей парой (номер, серия) наверху
+        using Head = std::tuple<int32_t, size_t, size_t>;
+        std::vector<Head> heap;
+        for (size_t part = begin; part < end; ++part) {
+            heap.clear();
+            for (size_t run = 0; run < numRuns; ++run) {
+                size_t pos = bounds[part * numRuns + run];
+                if (pos < bounds[(part + 1) * numRuns + run]) {
+                    heap.emplace_back(items.receiptId[pos], run, pos);
+                }
+            }
+            std::make_heap(heap.begin(), heap.end(), std::greater<>());
+            size_t out = offsets[part];
+            while (!heap.empty()) {
+                std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+                auto [id, run, pos] = heap.back();
+                size_t limit = bounds[(part + 1) * numRuns + run];
+                // Все позиции серии с этим номером чека переносятся подряд
+                do {
+                    merged.receiptId[out] = items.receiptId[pos];
+                    merged.productId[out] = items.productId[pos];
+                    merged.price[out] = items.price[pos];
+                    merged.quantity[out] = items.quantity[pos];
+                    ++out;
+                    ++pos;
+                } while (pos < limit && items.receiptId[pos] == id);
+                if (pos < limit) {
+                    heap.back() = {items.receiptId[pos], run, pos};
+                    std::push_heap(heap.begin(), heap.end(), std::greater<>());
+                } else {
+                    heap.pop_back();
+                }
+            }
+        }
+    });
+    return merged;
+}
+
+// Число различных номеров чеков в упорядоченных по номеру позициях
+size_t distinctReceiptIds(ReceiptView sorted) {
+    size_t distinct = sorted.size() > 0 ? 1 : 0;
+    for (size_t i = 1; i < sorted.size(); ++i) {
+        distinct += sorted.receiptId[i] != sorted.receiptId[i - 1];
+    }
+    return distinct;
+}
+
+// Загрузка позиций чеков из файлов в столбцовое хранилище: файлы отображаются в память,
+// каждый делится на фрагменты по границам строк, и фрагменты всех файлов разбираются
+// параллельно на одном пуле, так что загружены все ядра даже при множестве небольших файлов.
+// Фрагменты склеиваются в порядке файлов, названия товаров заносятся в dictionary в порядке
+// первого появления. Если номера чеков идут не по порядку (например, в файлах за разные дни
+// номера начинаются заново), позиции сливаются по номерам чеков (см. mergeByReceiptId).
+// Строки с одинаковым номером чека, как и в исходной загрузке, образуют один чек: их позиции
+// идут подряд в порядке файлов и строк
+ReceiptColumns loadReceiptColumns(const std::vector<std::string>& filenames, ProductDictionary& dictionary, ThreadPool& pool, LoadStats* stats = nullptr) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::unique_ptr<MappedFile>> files;
+    size_t totalBytes = 0;
+
+    // Фрагмент — участок [begin, end) одного файла
+    struct Chunk {
+        const char* begin;
+        const char* end;
+    };
+    std::vector<Chunk> bounds;
+    for (const std::string& filename : filenames) {
+        files.push_back(std::make_unique<MappedFile>(filename));
+        const char* data = files.back()->data();
+        size_t size = files.back()->size();
+        totalBytes += size;
+        if (size == 0) {
+            continue;
+        }
+
+        // Маленькие файлы нет смысла делить на много фрагментов
+        const size_t minChunk = 1 << 16;
+        size_t numChunks = std::min(static_cast<size_t>(pool.size()), size / minChunk + 1);
+
+        // Границы фрагментов сдвигаем вперёд до начала следующей строки
+        size_t from = 0;
+        for (size_t i = 1; i <= numChunks; ++i) {
+            size_t to = size;
+            if (i < numChunks) {
+                size_t pos = std::max(from, size / numChunks * i);
+                const void* nl = pos < size ? std::memchr(data + pos, '\n', size - pos) : nullptr;
+                to = nl ? static_cast<const char*>(nl) - data + 1 : size;
+            }
+            bounds.push_back({data + from, data + to});
+            from = to;
+        }
+    }
+    size_t numChunks = bounds.size();
+
+    std::vector<ChunkResult> chunks(numChunks);
+    pool.parallelFor(numChunks, 1, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            ScopedPhase phase("разбор фрагмента");
+            parseChunk(bounds[i].begin, bounds[i].end, chunks[i]);
+        }
+    });
+
+    // Переводим локальные номера товаров в общие. Фрагменты обходятся по порядку,
+    // поэтому номера совпадают с порядком первого появления товара в файлах
+    std::vector<std::vector<uint32_t>> remap(numChunks);
+    std::vector<size_t> offsets(numChunks + 1, 0);
+    ReceiptColumns columns;
+    size_t errors = 0;
+    {
+        ScopedPhase dictionaryPhase("общий словарь");
+        for (size_t i = 0; i < numChunks; ++i) {
+            for (size_t local = 0; local < chunks[i].dictionary.size(); ++local) {
+                remap[i].push_back(dictionary.intern(chunks[i].dictionary.name(static_cast<uint32_t>(local))));
+            }
+        }
+    }
+    for (size_t i = 0; i < numChunks; ++i) {
+        for (const auto& line : chunks[i].badLines) {
+            std::cerr << "Ошибка при чтении строки: " << line << "\n";
+        }
+        errors += chunks[i].errors;
+        columns.receiptCount += chunks[i].columns.receiptCount;
+        offsets[i + 1] = offsets[i] + chunks[i].columns.size();
+    }
+
+    // Склеиваем фрагменты в порядке следования в файлах (каждый поток копирует свой)
+    columns.resize(offsets[numChunks]);
+    auto copyChunk = [&](size_t i) {
+        ScopedPhase phase("склейка фрагментов");
+        ReceiptColumns& chunk = chunks[i].columns;
+        size_t offset = offsets[i];
+        std::copy(chunk.receiptId.begin(), chunk.receiptId.end(), columns.receiptId.begin() + offset);
+        std::copy(chunk.price.begin(), chunk.price.end(), columns.price.begin() + offset);
+        std::copy(chunk.quantity.begin(), chunk.quantity.end(), columns.quantity.begin() + offset);
+        for (size_t j = 0; j < chunk.size(); ++j) {
+            columns.productId[offset + j] = remap[i][chunk.productId[j]];
+        }
+        chunk = ReceiptColumns(); // память фрагмента больше не нужна
+    };
+    pool.parallelFor(numChunks, 1, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            copyChunk(i);
+        }
+    });
+
+    if (!std::is_sorted(columns.receiptId.begin(), columns.receiptId.end())) {
+        columns = mergeByReceiptId(columns.view(), pool);
+    }
+    columns.receiptCount = distinctReceiptIds(columns.view());
+
+    if (stats) {
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+        stats->bytes = totalBytes;
+        stats->receipts = columns.receiptCount;
+        stats->items = columns.size();
+        stats->errors = errors;
+        stats->seconds = duration.count();
+    }
+    return columns;
+}
+
+// Двоичный столбцовый формат файла с чеками (порядок байтов — как у процессора, little-endian):
+//   заголовок BinaryHeader;
+//   словарь товаров: для каждого товара uint32 длина названия и байты названия;
+//   четыре столбца по itemCount 32-битных значений: номер чека, номер товара,
+//   цена в копейках, количество. Каждый столбец начинается с границы 64 байт,
+//   поэтому после отображения файла в память столбцы используются без копирования
+struct BinaryHeader {
+    char magic[8];              // "RCPTBIN" и нулевой байт
+    uint32_t version;           // Версия формата
+    uint32_t productCount;      // Количество товаров в словаре
+    uint64_t receiptCount;      // Количество чеков
+    uint64_t itemCount;         // Количество позиций (длина каждого столбца)
+    uint64_t dictionaryOffset;  // Смещение словаря от начала файла
+    uint64_t dictionaryBytes;   // Размер словаря в байтах
+    uint64_t columnOffset[4];   // Смещения столбцов: номер чека, номер товара, цена, количество
 };
 
-// Класс для обработки данных о покупках
-class SalesProcessor {
+constexpr char binaryMagic[8] = {'R', 'C', 'P', 'T', 'B', 'I', 'N', '\0'};
+constexpr uint32_t binaryVersion = 1;
+
+// Запись всего буфера в файл (write может записать меньше запрошенного)
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Сохранение позиций чеков в двоичном формате
+bool saveReceiptsBinary(const std::string& filename, const ProductDictionary& dictionary, const ReceiptColumns& columns) {
+    auto align = [](uint64_t offset) { return (offset + 63) / 64 * 64; };
+
+    std::string names; // Словарь товаров
+    for (uint32_t product = 0; product < dictionary.size(); ++product) {
+        const std::string& name = dictionary.name(product);
+        uint32_t length = static_cast<uint32_t>(name.size());
+        names.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        names += name;
+    }
+
+    BinaryHeader header{};
+    std::memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+    header.version = binaryVersion;
+    header.productCount = static_cast<uint32_t>(dictionary.size());
+    header.receiptCount = columns.receiptCount;
+    header.itemCount = columns.size();
+    header.dictionaryOffset = sizeof(BinaryHeader);
+    header.dictionaryBytes = names.size();
+    uint64_t columnBytes = columns.size() * sizeof(int32_t);
+    header.columnOffset[0] = align(header.dictionaryOffset + header.dictionaryBytes);
+    for (int c = 1; c < 4; ++c) {
+        header.columnOffset[c] = align(header.columnOffset[c - 1] + columnBytes);
+    }
+
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Не удалось создать файл: " << filename << "\n";
+        return false;
+    }
+    const void* data[4] = {columns.receiptId.data(), columns.productId.data(), columns.price.data(), columns.quantity.data()};
+    const char zeros[64] = {};
+    uint64_t written = header.dictionaryOffset + header.dictionaryBytes;
+    bool ok = writeAll(fd, &header, sizeof(header)) && writeAll(fd, names.data(), names.size());
+    for (int c = 0; c < 4 && ok; ++c) {
+        ok = writeAll(fd, zeros, header.columnOffset[c] - written) && writeAll(fd, data[c], columnBytes);
+        written = header.columnOffset[c] + columnBytes;
+    }
+    ok = (::close(fd) == 0) && ok;
+    if (!ok) {
+        std::cerr << "Ошибка записи файла: " << filename << "\n";
+    }
+    return ok;
+}
+
+// Двоичный файл с чеками, отображённый в память. Столбцы не копируются:
+// view() указывает прямо на страницы файла
+class BinaryReceiptFile {
+public:
+    // Проверка, что файл записан в двоичном формате (по сигнатуре)
+    static bool isBinary(const std::string& filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        char magic[sizeof(binaryMagic)] = {};
+        bool binary = ::read(fd, magic, sizeof(magic)) == static_cast<ssize_t>(sizeof(magic)) && std::memcmp(magic, binaryMagic, sizeof(magic)) == 0;
+        ::close(fd);
+        return binary;
+    }
+
+    // Открывает файл и заполняет словарь товаров; возвращает false, если файл повреждён
+    bool open(const std::string& filename, ProductDictionary& dictionary) {
+        file = std::make_unique<MappedFile>(filename);
+        const char* data = file->data();
+        size_t size = file->size();
+        if (size < sizeof(BinaryHeader)) {
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) != 0 || header.version != binaryVersion) {
+            std::cerr << "Неподдерживаемый формат двоичного файла\n";
+            return false;
+        }
+        // Границы проверяются вычитанием и делением: сумма или произведение значений
+        // из повреждённого заголовка могут переполниться и пройти сравнение с размером
+        if (header.dictionaryOffset > size || header.dictionaryBytes > size - header.dictionaryOffset) {
+            return false;
+        }
+        for (uint64_t offset : header.columnOffset) {
+            if (offset % alignof(int32_t) != 0 || offset > size || header.itemCount > (size - offset) / sizeof(int32_t)) {
+                return false;
+            }
+        }
+
+        // Словарь небольшой, его названия копируются
+        std::vector<uint32_t> remap;
+        const char* p = data + header.dictionaryOffset;
+        const char* end = p + header.dictionaryBytes;
+        for (uint32_t product = 0; product < header.productCount; ++product) {
+            uint32_t length = 0;
+            if (end - p < static_cast<ptrdiff_t>(sizeof(length))) {
+                return false;
+            }
+            std::memcpy(&length, p, sizeof(length));
+            p += sizeof(length);
+            if (static_cast<size_t>(end - p) < length) {
+                return false;
+            }
+            remap.push_back(dictionary.intern(std::string_view(p, length)));
+            p += length;
+        }
+        // Номера товаров берутся из файла как есть, поэтому словарь должен совпасть с файловым
+        for (uint32_t product = 0; product < remap.size(); ++product) {
+            if (remap[product] != product) {
+                std::cerr << "Словарь товаров уже заполнен другими товарами\n";
+                return false;
+            }
+        }
+
+        auto column = [&](int c) { return data + header.columnOffset[c]; };
+        items.receiptId = {reinterpret_cast<const int32_t*>(column(0)), header.itemCount};
+        items.productId = {reinterpret_cast<const uint32_t*>(column(1)), header.itemCount};
+        items.price = {reinterpret_cast<const int32_t*>(column(2)), header.itemCount};
+        items.quantity = {reinterpret_cast<const int32_t*>(column(3)), header.itemCount};
+
+        // Номер товара используется как индекс массива, поэтому проверяем его заранее
+        uint32_t maxProduct = 0;
+        for (uint32_t product : items.productId) {
+            maxProduct = std::max(maxProduct, product);
+        }
+        if (header.itemCount > 0 && maxProduct >= header.productCount) {
+            std::cerr << "Номер товара вне словаря\n";
+            items = ReceiptView{};
+            return false;
+        }
+        return true;
+    }
+
+    ReceiptView view() const { return items; }
+    size_t receiptCount() const { return header.receiptCount; }
+    size_t size() const { return file ? file->size() : 0; }
+
 private:
-    std::vector<Receipt> receipts; // Список всех чеков
-    std::unordered_map<std::string, int> totalProductQuantity; // Суммарное количество проданных товаров по названию
-    std::unordered_map<std::string, std::vector<std::pair<int, double>>> productReceipts; // Карта товаров и чеков, в которых они присутствуют
-    std::mutex mtx; // Мьютекс для синхронизации доступа к общим данным в многопоточном режиме
+    std::unique_ptr<MappedFile> file;
+    BinaryHeader header{};
+    ReceiptView items;
+};
 
+// Ограниченная блокирующая очередь для передачи данных между стадиями конвейера
+template <typename T>
+class BoundedQueue {
 public:
-    // Конструктор, инициализирующий объект списком чеков
-    SalesProcessor(const std::vector<Receipt>& recs) : receipts(recs) {}
+    explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(capacity, 1)) {}
 
-    // Однопоточная обработка данных
-    void processSingleThread() {
-        for (const auto& receipt : receipts) {
-            processReceipt(receipt); // Обрабатываем каждый чек по порядку
+    // Ждёт свободного места; возвращает false, если очередь закрыта
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
         }
-        std::cout << std::endl;
-        printResults(); // Выводим результаты
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Ждёт элемента; возвращает false, если очередь закрыта и пуста
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Новых элементов не будет: ожидающие потоки просыпаются
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
     }
 
-    // Многопоточная обработка данных
-    void processMultiThread(int numThreads) {
-        std::vector<std::thread> threads; // Вектор потоков
-        int chunkSize = receipts.size() / numThreads; // Размер блока чеков, обрабатываемого каждым потоком
+private:
+    size_t capacity;
+    std::deque<T> items;
+    std::mutex mtx;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    bool closed = false;
+};
 
-        // Локальные контейнеры для хранения данных каждого потока
-        std::vector<std::unordered_map<std::string, int>> localProductQuantities(numThreads);
-        std::vector<std::unordered_map<std::string, std::vector<std::pair<int, double>>>> localProductReceipts(numThreads);
+// Параметры потоковой обработки
+struct StreamOptions {
+    size_t batchItems = 1 << 16;          // Позиций в одном пакете
+    size_t budgetBytes = 64 << 20;        // Сколько памяти могут занимать все пакеты одновременно
+    size_t readBytes = 1 << 20;           // Размер блока чтения файла
+};
 
-        // Создаем потоки
-        for (int i = 0; i < numThreads; ++i) {
-            int start = i * chunkSize; // Начальный индекс блока
-            int end = (i == numThreads - 1) ? receipts.size() : start + chunkSize; // Конечный индекс блока
+// Потоковая обработка файлов: стадия чтения разбирает строки в пакеты ограниченного размера
+// и передаёт их через очередь потокам пула, которые добавляют пакеты в processor.
+// Файлы читаются по очереди одним читателем, поэтому номера товаров в словаре
+// не зависят от числа потоков, а строки с одинаковым номером чека образуют один чек, как при
+// загрузке. Весь файл в памяти не хранится: число пакетов ограничено options.budgetBytes,
+// а обработанные пакеты возвращаются читателю для повторного использования. Если файл не
+// открылся или не прочитался, stats.failed = true
+LoadStats streamReceiptsFromFiles(const std::vector<std::string>& filenames, ProductDictionary& dictionary, SalesProcessor& processor, ThreadPool& pool, const StreamOptions& options = {}) {
+    auto start = std::chrono::high_resolution_clock::now();
+    LoadStats stats;
+
+    std::vector<int> fds;
+    for (const std::string& filename : filenames) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Не удалось открыть файл: " << filename << "\n";
+            for (int opened : fds) {
+                ::close(opened);
+            }
+            stats.failed = true;
+            return stats;
+        }
+        fds.push_back(fd);
+    }
+
+    // Пакет — это столбцы позиций; на одну позицию приходится 16 байт
+    const size_t batchItems = std::max<size_t>(options.batchItems, 1);
+    const size_t batchBytes = batchItems * (sizeof(int32_t) * 3 + sizeof(uint32_t));
+    const size_t maxBatches = std::max<size_t>(options.budgetBytes / batchBytes, 2);
+
+    using Batch = std::unique_ptr<ReceiptColumns>;
+    BoundedQueue<std::pair<size_t, Batch>> fullBatches(maxBatches); // Разобранные пакеты с порядковыми номерами
+    BoundedQueue<Batch> emptyBatches(maxBatches); // Пакеты, которые можно заполнять снова
+    for (size_t i = 0; i < maxBatches; ++i) {
+        emptyBatches.push(std::make_unique<ReceiptColumns>());
+    }
 
-            threads.emplace_back([this, start, end, &localProductQuantities, &localProductReceipts, i]() {
-                // Обработка блоков чеков каждым потоком
-                for (int j = start; j < end; ++j) {
-                    processReceipt(receipts[j], localProductQuantities[i], localProductReceipts[i]);
+    ChunkResult errors; // Здесь используются только сведения об ошибках
+    std::thread reader([&]() {
+        ScopedPhase readerPhase("чтение и разбор");
+        std::vector<char> buffer(std::max<size_t>(options.readBytes, 4096));
+        Batch batch;
+        size_t sequence = 0; // Номер пакета в порядке чтения
+        for (size_t file = 0; file < fds.size(); ++file) {
+            size_t carry = 0; // Незаконченная строка из предыдущего блока
+            bool eof = false;
+            while (!eof) {
+                if (carry == buffer.size()) {
+                    buffer.resize(buffer.size() * 2); // строка длиннее блока чтения
                 }
-            });
+                ssize_t n;
+                {
+                    ScopedPhase phase("чтение файла");
+                    n = ::read(fds[file], buffer.data() + carry, buffer.size() - carry);
+                }
+                if (n < 0) {
+                    std::cerr << "Ошибка чтения файла: " << filenames[file] << "\n";
+                    stats.failed = true;
+                }
+                eof = n <= 0;
+                size_t filled = carry + (n > 0 ? n : 0);
+                stats.bytes += n > 0 ? n : 0;
+
+                const char* p = buffer.data();
+                const char* end = p + filled;
+                while (p < end) {
+                    const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+                    if (!lineEnd) {
+                        if (!eof) {
+                            break; // дочитаем строку со следующим блоком
+                        }
+                        lineEnd = end;
+                    }
+                    if (skipSpaces(p, lineEnd) != lineEnd) {
+                        if (!batch) {
+                            ScopedPhase phase("ожидание пакета");
+                            emptyBatches.pop(batch); // ждём, пока обработчики вернут пакет
+                        }
+                        if (!parseLine(p, lineEnd, *batch, dictionary)) {
+                            errors.addError(p, lineEnd);
+                        }
+                        if (batch->size() >= batchItems) {
+                            fullBatches.push({sequence++, std::move(batch)});
+                        }
+                    }
+                    p = lineEnd + 1;
+                }
+                carry = p < end ? end - p : 0;
+                std::memmove(buffer.data(), end - carry, carry);
+            }
         }
+        if (batch && batch->size() > 0) {
+            fullBatches.push({sequence++, std::move(batch)});
+        }
+        fullBatches.close();
+    });
 
-        // Ожидание завершения всех потоков
-        for (auto& t : threads) {
-            t.join();
+    // Каждый поток пула забирает пакеты из очереди, пока читатель не закончит. Пакеты
+    // добавляются в processor в порядке чтения, поэтому результат не зависит от числа потоков
+    std::mutex statsMutex;
+    pool.parallelFor(pool.size(), 1, [&](size_t, size_t, int) {
+        std::pair<size_t, Batch> item;
+        size_t items = 0;
+        while (fullBatches.pop(item)) {
+            ScopedPhase phase("добавление пакета");
+            Batch& batch = item.second;
+            processor.append(batch->view(), item.first);
+            items += batch->size();
+            batch->resize(0);
+            batch->receiptCount = 0;
+            emptyBatches.push(std::move(batch));
         }
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.items += items;
+    });
+    reader.join();
+    for (int fd : fds) {
+        ::close(fd);
+    }
 
-        // Слияние локальных данных в общий результат
-        for (const auto& localQuantity : localProductQuantities) {
-            for (const auto& [product, quantity] : localQuantity) {
-                totalProductQuantity[product] += quantity; // Суммируем количество проданных товаров
-            }
+    {
+        ScopedPhase phase("упорядочение списков");
+        processor.orderReceiptLists(pool);
+    }
+    stats.receipts = processor.distinctReceiptCount();
+
+    for (const auto& line : errors.badLines) {
+        std::cerr << "Ошибка при чтении строки: " << line << "\n";
+    }
+    std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+    stats.errors = errors.errors;
+    stats.seconds = duration.count();
+    return stats;
+}
+
+// Пиковое потребление памяти процессом в мегабайтах
+double peakMemoryMB() {
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0; // в Linux ru_maxrss задаётся в килобайтах
+}
+
+// Построение обратного индекса и запросы к нему: чеки с товаром, чеки с двумя товарами
+// (по первым двум названиям из --with или первым двум товарам словаря) и самые дорогие чеки
+void runIndexQueries(const ProductDictionary& dictionary, ReceiptView items, ThreadPool& pool,
+                     const std::vector<std::string>& names, size_t topCount) {
+    auto start = std::chrono::high_resolution_clock::now();
+    ReceiptIndex index(items, dictionary.size(), pool, std::max<size_t>(topCount, 1000));
+    std::chrono::duration<double> buildDuration = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "Индекс построен за " << buildDuration.count() << " секунд: " << index.memoryBytes() / (1024.0 * 1024.0)
+              << " МБ (списки ReceiptRef: " << items.size() * sizeof(ReceiptRef) / (1024.0 * 1024.0)
+              << " МБ, пары <int, double>: " << items.size() * sizeof(std::pair<int, double>) / (1024.0 * 1024.0) << " МБ)\n";
+
+    std::vector<uint32_t> products;
+    for (const std::string& name : names) {
+        uint32_t product = dictionary.find(name);
+        if (product == ProductDictionary::npos) {
+            std::cout << "Товар не найден: " << name << "\n";
+            return;
+        }
+        products.push_back(product);
+    }
+    for (uint32_t product = 0; products.size() < 2 && product < dictionary.size(); ++product) {
+        if (names.empty()) {
+            products.push_back(product);
+        }
+    }
+
+    auto elapsedMicroseconds = [](auto from) {
+        return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - from).count();
+    };
+    auto printIds = [](const auto& ids, auto idOf) {
+        for (size_t i = 0; i < std::min<size_t>(ids.size(), 10); ++i) {
+            std::cout << (i > 0 ? ", " : " ") << idOf(ids[i]);
+        }
+        std::cout << (ids.size() > 10 ? ", ...\n" : "\n");
+    };
+
+    for (uint32_t product : products) {
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<ReceiptRef> receipts = index.receiptsWith(product);
+        double micros = elapsedMicroseconds(start);
+        std::cout << "Чеки с товаром " << dictionary.name(product) << ": " << receipts.size() << " за " << micros << " мкс:";
+        printIds(receipts, [](const ReceiptRef& r) { return r.receiptId; });
+    }
+    if (products.size() >= 2) {
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<int32_t> both = index.receiptsWithBoth(products[0], products[1]);
+        double micros = elapsedMicroseconds(start);
+        std::cout << "Чеки с товарами " << dictionary.name(products[0]) << " и " << dictionary.name(products[1]) << ": "
+                  << both.size() << " за " << micros << " мкс:";
+        printIds(both, [](int32_t id) { return id; });
+    }
+
+    start = std::chrono::high_resolution_clock::now();
+    std::vector<ReceiptSpend> top = index.topReceiptsBySpend(topCount);
+    double micros = elapsedMicroseconds(start);
+    std::cout << "Самые дорогие чеки (" << micros << " мкс):\n";
+    for (const ReceiptSpend& receipt : top) {
+        std::cout << " - Номер чека: " << receipt.receiptId << ", Сумма: " << receipt.spend / 100.0 << "\n";
+    }
+}
+
+// Сумма в копейках как рубли с двумя знаками после точки: 123456789 -> "1234567.89"
+inline std::string formatRubles(long long kopecks) {
+    unsigned long long value = kopecks < 0 ? 0ULL - static_cast<unsigned long long>(kopecks) : kopecks;
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%s%llu.%02llu", kopecks < 0 ? "-" : "", value / 100, value % 100);
+    return buffer;
+}
+
+// Запросы к аналитике: итоги по диапазону номеров чеков [from, to] (при from > to — средняя
+// половина всех номеров) для всех товаров и выбранных (--with или самых продаваемых),
+// самые продаваемые товары и число различных чеков с товаром. Если переданы позиции,
+// ответы сверяются с полным просмотром. В конце замеряется время одного запроса каждого вида
+void runAnalyticsQueries(const ProductDictionary& dictionary, const SalesAnalytics& analytics, ReceiptView items,
+                         const std::vector<std::string>& names, size_t topCount, int32_t from, int32_t to) {
+    if (analytics.productCount() == 0) {
+        std::cout << "Нет данных для запросов\n";
+        return;
+    }
+    if (from > to) {
+        long long span = static_cast<long long>(analytics.maxReceiptId()) - analytics.minReceiptId();
+        from = static_cast<int32_t>(analytics.minReceiptId() + span / 4);
+        to = static_cast<int32_t>(analytics.minReceiptId() + span * 3 / 4);
+    }
+    std::cout << "Аналитика: накопленные суммы " << analytics.prefixBytes() / (1024.0 * 1024.0) << " МБ, HyperLogLog и Space-Saving "
+              << analytics.sketchBytes() / (1024.0 * 1024.0) << " МБ\n";
+
+    auto elapsedMicroseconds = [](auto since) {
+        return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - since).count();
+    };
+    auto printTotals = [](const RangeTotals& totals) {
+        std::cout << "количество " << totals.quantity << ", выручка " << formatRubles(totals.revenue) << ", чеков " << totals.receipts;
+    };
+
+    std::vector<uint32_t> products;
+    for (const std::string& name : names) {
+        uint32_t product = dictionary.find(name);
+        if (product == ProductDictionary::npos) {
+            std::cout << "Товар не найден: " << name << "\n";
+            return;
         }
+        products.push_back(product);
+    }
+    if (products.empty()) {
+        for (const SpaceSaving::Counter& counter : analytics.topByRevenue(3)) {
+            products.push_back(counter.key);
+        }
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    RangeTotals overall = analytics.range(from, to);
+    double micros = elapsedMicroseconds(start);
+    std::cout << "Чеки с номерами от " << from << " до " << to << " (" << micros << " мкс):\n - все товары: ";
+    printTotals(overall);
+    std::cout << "\n";
+    for (uint32_t product : products) {
+        std::cout << " - " << dictionary.name(product) << ": ";
+        printTotals(analytics.productRange(product, from, to));
+        std::cout << "\n";
+    }
 
-        for (const auto& localReceipts : localProductReceipts) {
-            for (const auto& [product, receipts] : localReceipts) {
-                productReceipts[product].insert(productReceipts[product].end(), receipts.begin(), receipts.end()); // Объединяем данные о чеках
+    // Сверка с полным просмотром позиций: итоги всех товаров по диапазону за один проход
+    if (items.size() > 0) {
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<RangeTotals> scanned(analytics.productCount());
+        RangeTotals scannedOverall;
+        std::vector<int32_t> lastReceipt(analytics.productCount(), INT32_MIN);
+        int32_t lastOverall = INT32_MIN;
+        for (size_t i = 0; i < items.size(); ++i) {
+            int32_t receiptId = items.receiptId[i];
+            if (receiptId < from || receiptId > to) {
+                continue;
             }
+            uint32_t product = items.productId[i];
+            long long revenue = static_cast<long long>(items.price[i]) * items.quantity[i];
+            scanned[product].quantity += items.quantity[i];
+            scanned[product].revenue += revenue;
+            scanned[product].receipts += lastReceipt[product] != receiptId;
+            lastReceipt[product] = receiptId;
+            scannedOverall.quantity += items.quantity[i];
+            scannedOverall.revenue += revenue;
+            scannedOverall.receipts += lastOverall != receiptId;
+            lastOverall = receiptId;
         }
-        std::cout << std::endl;
-        printResults();
+        double scanMicros = elapsedMicroseconds(start);
+        auto same = [](const RangeTotals& a, const RangeTotals& b) {
+            return a.quantity == b.quantity && a.revenue == b.revenue && a.receipts == b.receipts;
+        };
+        size_t mismatches = !same(overall, scannedOverall);
+        for (uint32_t product = 0; product < scanned.size(); ++product) {
+            mismatches += !same(analytics.productRange(product, from, to), scanned[product]);
+        }
+        std::cout << "Полный просмотр позиций: " << scanMicros << " мкс, "
+                  << (mismatches == 0 ? "итоги совпадают" : "расхождений: " + std::to_string(mismatches)) << "\n";
     }
 
-    // Функция для обработки одного чека (однопоточная версия)
-    void processReceipt(const Receipt& receipt) {
-        for (const auto& product : receipt.products) {
-            std::lock_guard<std::mutex> lock(mtx); // Блокируем доступ для синхронизации
-            totalProductQuantity[product.name] += product.quantity; // Увеличиваем общее количество проданных товаров
-            productReceipts[product.name].emplace_back(receipt.id, product.price); // Добавляем информацию о чеке
+    // Самые продаваемые товары по оценке Space-Saving и точные итоги для сравнения
+    start = std::chrono::high_resolution_clock::now();
+    std::vector<SpaceSaving::Counter> top = analytics.topByRevenue(topCount);
+    micros = elapsedMicroseconds(start);
+    std::cout << "Самые продаваемые товары по выручке (" << micros << " мкс):\n";
+    for (const SpaceSaving::Counter& counter : top) {
+        std::cout << " - " << dictionary.name(counter.key) << ": " << formatRubles(counter.count);
+        if (counter.error > 0) {
+            std::cout << " (погрешность до " << formatRubles(counter.error) << ")";
+        }
+        std::cout << ", точно " << formatRubles(analytics.productTotals(counter.key).revenue) << "\n";
+    }
+    std::cout << "Самые продаваемые товары по количеству:\n";
+    for (const SpaceSaving::Counter& counter : analytics.topByQuantity(topCount)) {
+        std::cout << " - " << dictionary.name(counter.key) << ": " << counter.count;
+        if (counter.error > 0) {
+            std::cout << " (погрешность до " << counter.error << ")";
+        }
+        std::cout << ", точно " << analytics.productTotals(counter.key).quantity << "\n";
+    }
+
+    // Оценки HyperLogLog против точного числа чеков: для выбранных товаров и наибольшая погрешность.
+    // На единицах чеков одно совпадение регистров даёт десятки процентов, поэтому такие товары не учитываются
+    double maxError = 0;
+    for (uint32_t product = 0; product < analytics.productCount(); ++product) {
+        size_t exact = analytics.productTotals(product).receipts;
+        if (exact >= 1000) {
+            maxError = std::max(maxError, std::abs(analytics.distinctReceipts(product) - exact) / exact);
+        }
+    }
+    std::cout << "Различных чеков с товаром (HyperLogLog, наибольшая погрешность для товаров от 1000 чеков " << maxError * 100 << "%):\n";
+    for (uint32_t product : products) {
+        std::cout << " - " << dictionary.name(product) << ": " << std::llround(analytics.distinctReceipts(product))
+                  << ", точно " << analytics.productTotals(product).receipts << "\n";
+    }
+
+    // Время одного запроса: случайные товары и диапазоны заготавливаются заранее
+    constexpr size_t numQueries = 1 << 20;
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int32_t> ids(analytics.minReceiptId(), analytics.maxReceiptId());
+    std::uniform_int_distribution<uint32_t> productIds(0, static_cast<uint32_t>(analytics.productCount() - 1));
+    std::vector<std::pair<int32_t, int32_t>> ranges(numQueries);
+    std::vector<uint32_t> queryProducts(numQueries);
+    for (size_t i = 0; i < numQueries; ++i) {
+        int32_t a = ids(random);
+        int32_t b = ids(random);
+        ranges[i] = {std::min(a, b), std::max(a, b)};
+        queryProducts[i] = productIds(random);
+    }
+    long long checksum = 0; // чтобы компилятор не выбросил запросы
+    auto nanosPerQuery = [&](size_t count, auto&& query) {
+        auto since = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            query(i);
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - since).count() / count;
+    };
+    double productNanos = nanosPerQuery(numQueries, [&](size_t i) {
+        checksum += analytics.productRange(queryProducts[i], ranges[i].first, ranges[i].second).quantity;
+    });
+    double overallNanos = nanosPerQuery(numQueries, [&](size_t i) {
+        checksum += analytics.range(ranges[i].first, ranges[i].second).revenue;
+    });
+    double distinctNanos = nanosPerQuery(numQueries, [&](size_t i) {
+        checksum += static_cast<long long>(analytics.distinctReceipts(queryProducts[i]));
+    });
+    double topNanos = nanosPerQuery(numQueries / 64, [&](size_t) {
+        checksum += analytics.topByRevenue(topCount).front().count;
+    });
+    std::cout << "Время запроса: итоги товара по диапазону " << productNanos << " нс, итоги всех товаров " << overallNanos
+              << " нс, число чеков с товаром " << distinctNanos << " нс, top-" << topCount << " " << topNanos
+              << " нс (контрольная сумма " << checksum << ")\n";
+}
+
+// Сводные показатели по товарам: замер скалярного и выбранного ядра в одном потоке
+// и на пуле, сверка результатов и вывод таблицы
+void runTotalsKernels(const ProductDictionary& dictionary, ReceiptView items, ThreadPool& pool, OutputSink& sink) {
+    ThreadPool single(1);
+    double megabytes = items.size() * (sizeof(uint32_t) + 2 * sizeof(int32_t)) / (1024.0 * 1024.0);
+    std::vector<ProductTotals> reference;
+    std::vector<ProductTotals> totals;
+    bool same = true;
+
+    auto run = [&](TotalsKernel kernel, ThreadPool& target) {
+        auto start = std::chrono::high_resolution_clock::now();
+        totals = aggregateColumns(items, dictionary.size(), target, kernel);
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+        if (reference.empty()) {
+            reference = totals;
         }
+        for (size_t product = 0; product < totals.size(); ++product) {
+            const ProductTotals& a = totals[product];
+            const ProductTotals& b = reference[product];
+            same = same && a.quantity == b.quantity && a.revenue == b.revenue && a.count == b.count &&
+                   a.minPrice == b.minPrice && a.maxPrice == b.maxPrice;
+        }
+        std::cout << "Ядро " << totalsKernelName(kernel) << " (" << target.size() << " потоков): " << duration.count()
+                  << " секунд, " << (duration.count() > 0 ? megabytes / duration.count() : 0) << " МБ/с\n";
+    };
+
+    run(TotalsKernel::Scalar, single);
+    TotalsKernel best = bestTotalsKernel();
+    if (best != TotalsKernel::Scalar) {
+        run(best, single);
     }
+    run(best, pool);
+    if (!same) {
+        std::cout << "ОШИБКА: результаты ядер не совпадают\n";
+    }
+    std::cout << std::endl;
+    writeTotalsReport(sink, dictionary, totals);
+}
+
+// Сравнение режимов одновременного обновления общих результатов несколькими потоками:
+// общий мьютекс (GlobalMutexAggregator), шарды с shared_mutex и локальные массивы потоков
+// с последующим слиянием (processMultiThread). Пока идёт загрузка, отдельный поток
+// запрашивает итоги и копии списков чеков по товарам, а ещё один периодически выводит
+// полный отчёт в NullSink, чтобы показать, насколько чтение возможно параллельно с записью
+void runConcurrentBenchmark(const ProductDictionary& dictionary, ReceiptView items, ThreadPool& pool, size_t numShards) {
+    SalesProcessor reference(dictionary, items);
+    auto start = std::chrono::high_resolution_clock::now();
+    reference.processMultiThread(pool);
+    std::chrono::duration<double> localDuration = std::chrono::high_resolution_clock::now() - start;
+
+    auto report = [&](const std::string& title, double seconds, const std::string& queries, bool correct) {
+        std::cout << title << ": " << seconds << " секунд, " << (seconds > 0 ? items.size() / seconds : 0)
+                  << " позиций/с, во время загрузки: " << queries
+                  << (correct ? "" : " — ОШИБКА: итоги не совпадают") << "\n";
+    };
+
+    auto measure = [&](auto& aggregator, const std::string& title) {
+        std::atomic<bool> done{false};
+        size_t queries = 0;
+        size_t copies = 0;
+        size_t reports = 0;
+        std::thread reader([&]() {
+            uint32_t product = 0;
+            long long sink = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                sink += aggregator.quantityOf(product);
+                if (++queries % 64 == 0) {
+                    sink += aggregator.receiptsOf(product).size();
+                    ++copies;
+                }
+                product = dictionary.size() > 0 ? (product + 1) % dictionary.size() : 0;
+            }
+            (void)sink;
+        });
+        std::thread reporter([&]() {
+            NullSink sink;
+            ThreadPool reportPool(1);
+            // Отчёт раз в 100 мс: без пауз общий мьютекс почти не отпускался бы для записи
+            while (!done.load(std::memory_order_relaxed)) {
+                aggregator.printResults(sink, reportPool);
+                ++reports;
+                for (int i = 0; i < 10 && !done.load(std::memory_order_relaxed); ++i) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            }
+        });
 
-    // Перегруженная функция для обработки одного чека (многопоточная версия)
-    void processReceipt(const Receipt& receipt, std::unordered_map<std::string, int>& localQuantity, std::unordered_map<std::string, std::vector<std::pair<int, double>>>& localReceipts) {
-        for (const auto& product : receipt.products) {
-            localQuantity[product.name] += product.quantity; // Увеличиваем количество проданных товаров в локальном контейнере
-            localReceipts[product.name].emplace_back(receipt.id, product.price); // Добавляем информацию о чеке в локальный контейнер
+        auto begin = std::chrono::high_resolution_clock::now();
+        aggregator.processAll(items, pool);
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - begin;
+        done = true;
+        reader.join();
+        reporter.join();
+
+        bool correct = true;
+        for (uint32_t product = 0; product < dictionary.size(); ++product) {
+            correct = correct && aggregator.quantityOf(product) == reference.quantityOf(product)
+                && aggregator.receiptsOf(product).size() == reference.receiptCountOf(product);
         }
+        report(title, duration.count(), "запросов итогов " + std::to_string(queries) + ", копий списков "
+               + std::to_string(copies) + ", отчётов " + std::to_string(reports), correct);
+    };
+
+    std::cout << "Одновременное обновление (" << pool.size() << " потоков, " << items.size() << " позиций)\n";
+    {
+        GlobalMutexAggregator aggregator(dictionary);
+        measure(aggregator, "Общий мьютекс");
     }
+    {
+        ShardedSalesAggregator aggregator(dictionary, numShards);
+        measure(aggregator, "Шарды (" + std::to_string(aggregator.shardCount()) + ")");
+    }
+    report("Локальные массивы потоков", localDuration.count(), "запросы невозможны", true);
+}
 
-    // Вывод результатов обработки на экран
-    void printResults() const {
-        for (const auto& [product, quantity] : totalProductQuantity) {
-            std::cout << "Товар: " << product << ", Общее количество продано: " << quantity << "\n";
-            std::cout << "Чеки, содержащие " << product << ":\n";
-            for (const auto& [receiptId, price] : productReceipts.at(product)) {
-                std::cout << " - Номер чека: " << receiptId << ", Цена: " << price << "\n";
+// Параметры серии замеров (--bench)
+struct BenchmarkOptions {
+    int warmup = 1;            // Прогревочные запуски (не учитываются)
+    int trials = 7;            // Учитываемые запуски
+    std::vector<int> threads;  // Числа потоков; по умолчанию 1..hardware_concurrency
+    std::string csvFile;       // Файл CSV (дописывается; заголовок — если файл пуст)
+    AffinityPolicy affinity = AffinityPolicy::None; // Закрепление потоков пулов
+    std::vector<std::string> streamInputs; // Текстовые файлы для режима stream (пусто — режим не замеряется)
+};
+
+// Статистика серии запусков, в миллисекундах
+struct TrialStats {
+    double median = 0;
+    double mean = 0;
+    double stddev = 0;
+    double ci95 = 0; // Полуширина 95% доверительного интервала для среднего (t-распределение)
+    double min = 0;
+    double max = 0;
+
+    static TrialStats of(std::vector<double> samples) {
+        // Квантили t-распределения для двустороннего 95% интервала, df = 1..30
+        static const double t95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                     2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                     2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+        TrialStats stats;
+        if (samples.empty()) {
+            return stats;
+        }
+        std::sort(samples.begin(), samples.end());
+        size_t n = samples.size();
+        stats.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+        stats.min = samples.front();
+        stats.max = samples.back();
+        for (double x : samples) {
+            stats.mean += x / n;
+        }
+        if (n > 1) {
+            double sum = 0;
+            for (double x : samples) {
+                sum += (x - stats.mean) * (x - stats.mean);
             }
+            stats.stddev = std::sqrt(sum / (n - 1));
+            stats.ci95 = (n - 1 <= std::size(t95) ? t95[n - 2] : 1.96) * stats.stddev / std::sqrt(static_cast<double>(n));
         }
+        return stats;
     }
 };
 
-// Функция для загрузки данных о чеках из файла
-std::vector<Receipt> loadReceiptsFromFile(const std::string& filename) {
-    std::ifstream file(filename); // Открываем файл
-    std::string line;
-    std::unordered_map<int, Receipt> receiptsMap; // Используем временную карту для объединения данных по идентификаторам чеков
+// Итоги режима для сверки: количество и число записей о чеках по каждому товару
+struct ModeTotals {
+    std::vector<long long> quantity;
+    std::vector<size_t> entries;
 
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        int id;
-        std::string name;
-        double price;
-        int quantity;
+    bool operator==(const ModeTotals&) const = default;
+};
 
-        // Читаем строку с данными
-        if (!(iss >> id >> name >> price >> quantity)) {
-            std::cerr << "Ошибка при чтении строки: " << line << "\n"; // Если ошибка, выводим сообщение и пропускаем строку
-            continue;
+// Серия замеров всех режимов обработки на одном наборе данных: однопоточный, многопоточный
+// с локальными массивами, шардированный агрегатор и ядро сводных показателей — для каждого
+// числа потоков. После прогрева каждый режим запускается trials раз; итоги всех режимов
+// сверяются с однопоточным. Возвращает false, если итоги разошлись
+bool runBenchmark(const std::string& dataset, const ProductDictionary& dictionary, ReceiptView items, const BenchmarkOptions& options) {
+    std::vector<int> threadCounts = options.threads;
+    if (threadCounts.empty()) {
+        for (int t = 1; t <= static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++t) {
+            threadCounts.push_back(t);
+        }
+    }
+    size_t numProducts = dictionary.size();
+
+    // Замер одного режима: run(pool) выполняет обработку и возвращает итоги для сверки
+    auto measure = [&](ThreadPool& pool, auto&& run, ModeTotals& totals) {
+        std::vector<double> samples;
+        for (int trial = 0; trial < options.warmup + options.trials; ++trial) {
+            auto start = std::chrono::high_resolution_clock::now();
+            ModeTotals result = run(pool);
+            std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+            if (trial >= options.warmup) {
+                samples.push_back(duration.count());
+            }
+            totals = std::move(result);
+        }
+        return TrialStats::of(samples);
+    };
+
+    auto collect = [&](auto&& quantityOf, auto&& countOf) {
+        ModeTotals totals{std::vector<long long>(numProducts), std::vector<size_t>(numProducts)};
+        for (uint32_t product = 0; product < numProducts; ++product) {
+            totals.quantity[product] = quantityOf(product);
+            totals.entries[product] = countOf(product);
+        }
+        return totals;
+    };
+
+    auto single = [&](ThreadPool&) {
+        SalesProcessor processor(dictionary, items);
+        processor.processSingleThread();
+        return collect([&](uint32_t p) { return processor.quantityOf(p); }, [&](uint32_t p) { return processor.receiptCountOf(p); });
+    };
+    // Многопоточные режимы читают input: при закреплении потоков это копия, размещённая по узлам
+    ReceiptView input = items;
+    std::vector<size_t> workerItems; // Позиции по потокам в последнем многопоточном запуске
+    auto multi = [&](ThreadPool& pool) {
+        SalesProcessor processor(dictionary, input);
+        processor.processMultiThread(pool);
+        workerItems = processor.itemsPerWorker();
+        return collect([&](uint32_t p) { return processor.quantityOf(p); }, [&](uint32_t p) { return processor.receiptCountOf(p); });
+    };
+    auto sharded = [&](ThreadPool& pool) {
+        ShardedSalesAggregator aggregator(dictionary, 16);
+        aggregator.processAll(input, pool);
+        return collect([&](uint32_t p) { return aggregator.quantityOf(p); }, [&](uint32_t p) { return aggregator.receiptCountOf(p); });
+    };
+    auto kernel = [&](ThreadPool& pool) {
+        std::vector<ProductTotals> totals = aggregateColumns(input, numProducts, pool);
+        return collect([&](uint32_t p) { return totals[p].quantity; }, [&](uint32_t p) { return static_cast<size_t>(totals[p].count); });
+    };
+    // Потоковый режим сам читает и разбирает файлы, поэтому его время включает загрузку.
+    // Словарь у него свой: итоги сверяются по названиям товаров
+    bool streamFailed = false;
+    auto stream = [&](ThreadPool& pool) {
+        ProductDictionary streamDictionary;
+        SalesProcessor processor(streamDictionary);
+        streamFailed = streamReceiptsFromFiles(options.streamInputs, streamDictionary, processor, pool).failed || streamFailed;
+        auto idOf = [&](uint32_t p) { return streamDictionary.find(dictionary.name(p)); };
+        return collect([&](uint32_t p) { uint32_t id = idOf(p); return id == ProductDictionary::npos ? 0LL : processor.quantityOf(id); },
+                       [&](uint32_t p) { uint32_t id = idOf(p); return id == ProductDictionary::npos ? size_t{0} : processor.receiptCountOf(id); });
+    };
+
+    bool writeHeader = false;
+    std::ofstream csv;
+    if (!options.csvFile.empty()) {
+        csv.open(options.csvFile, std::ios::app);
+        writeHeader = csv.tellp() == 0;
+        if (!csv) {
+            std::cerr << "Не удалось открыть файл: " << options.csvFile << "\n";
+        }
+    }
+    if (writeHeader) {
+        csv << "dataset,mode,threads,items,trials,median_ms,mean_ms,stddev_ms,ci95_ms,min_ms,max_ms,speedup,correct,affinity,nodes\n";
+    }
+
+    std::cout << "Набор " << dataset << ": " << items.size() << " позиций, прогрев " << options.warmup
+              << ", запусков " << options.trials << ", закрепление " << affinityPolicyName(options.affinity) << " (время в мс)\n";
+    CpuTopology topology = CpuTopology::detect();
+    ModeTotals reference;
+    double baseline = 0;
+    bool allCorrect = true;
+    // nodes — пропускная способность по узлам NUMA (только для режима multi, где известна работа потоков)
+    auto report = [&](const char* mode, int threads, const TrialStats& stats, bool correct, const std::string& nodes = "") {
+        double speedup = stats.median > 0 ? baseline / stats.median : 0;
+        allCorrect = allCorrect && correct;
+        std::cout << "  " << mode << " (" << threads << " потоков): медиана " << stats.median << " ± " << stats.ci95
+                  << " (σ " << stats.stddev << ", " << stats.min << "–" << stats.max << "), ускорение " << speedup
+                  << (nodes.empty() ? "" : "; " + nodes)
+                  << (correct ? "" : " — ОШИБКА: итоги не совпадают с однопоточными") << "\n";
+        if (csv) {
+            csv << dataset << "," << mode << "," << threads << "," << items.size() << "," << options.trials << ","
+                << stats.median << "," << stats.mean << "," << stats.stddev << "," << stats.ci95 << ","
+                << stats.min << "," << stats.max << "," << speedup << "," << (correct ? 1 : 0) << ","
+                << affinityPolicyName(options.affinity) << ",\"" << nodes << "\"\n";
+        }
+    };
+
+    {
+        ThreadPool pool(1);
+        TrialStats stats = measure(pool, single, reference);
+        baseline = stats.median;
+        report("single", 1, stats, true);
+    }
+    for (int threads : threadCounts) {
+        ThreadPool pool(threads);
+        PlacedColumns placed;
+        input = items;
+        if (options.affinity != AffinityPolicy::None) {
+            applyAffinity(pool, topology, options.affinity);
+            placed = PlacedColumns(items, pool);
+            input = placed.view();
+        }
+        ModeTotals totals;
+        TrialStats stats = measure(pool, multi, totals);
+        report("multi", threads, stats, totals == reference, nodeThroughput(pool, workerItems, stats.median / 1000));
+        stats = measure(pool, sharded, totals);
+        report("sharded", threads, stats, totals == reference);
+        stats = measure(pool, kernel, totals);
+        report("totals-kernel", threads, stats, totals == reference);
+        if (!options.streamInputs.empty()) {
+            stats = measure(pool, stream, totals);
+            report("stream", threads, stats, !streamFailed && totals == reference);
         }
+    }
+    return allCorrect;
+}
+
+const char* const usage =
+    "Использование: zad2 [файл или шаблон]... [--threads N] [--stream] [--batch N] [--budget-mb N] [--convert файл.bin]\n"
+    "                    [--output файл] [--summary] [--concurrent] [--shards N] [--totals]\n"
+    "                    [--index] [--with товар]... [--top N] [--arena]\n"
+    "                    [--query] [--range от,до]\n"
+    "                    [--profile] [--counters] [--trace файл.json]\n"
+    "                    [--bench] [--trials N] [--warmup N] [--bench-threads 1,2,4] [--csv файл]\n"
+    "                    [--affinity compact|scatter|node|none]\n";
+
+// Параметры запуска (см. usage)
+struct Options {
+    std::vector<std::string> inputs; // Файлы с чеками (по умолчанию receiptsUltraMini.txt)
+    bool badInputs = false;          // Какой-то из файлов не найден
+    bool badOptions = false;         // Ошибка в командной строке: неизвестный параметр или неверное значение
+    int numThreads = std::max(1u, std::thread::hardware_concurrency()); // Количество потоков
+    bool stream = false;  // Потоковая обработка без загрузки всего файла
+    StreamOptions streamOptions;
+    std::string convertTo; // Сохранить чеки в двоичном формате в этот файл и завершиться
+    std::string outputFile; // Файл для результатов (по умолчанию стандартный вывод)
+    OutputMode outputMode = OutputMode::Full;
+    bool concurrent = false; // Сравнить режимы одновременного обновления
+    size_t shards = 16;      // Число шардов для режима одновременного обновления
+    bool totals = false;     // Вывести сводные показатели (выручка, цены) вместо отчёта по чекам
+    bool index = false;      // Построить обратный индекс и выполнить запросы по нему
+    std::vector<std::string> indexProducts; // Товары для запросов по индексу и аналитике
+    bool query = false;      // Построить аналитику за один проход и выполнить запросы к ней
+    int32_t rangeFrom = 0;   // Диапазон номеров чеков для запросов (при rangeFrom > rangeTo — средняя половина)
+    int32_t rangeTo = -1;
+    bool arena = false;      // Размещать результаты обработки в арене (monotonic_buffer_resource)
+    bool profile = false;    // Вывести профиль этапов
+    bool counters = false;   // Добавить в профиль аппаратные счётчики (perf_event_open)
+    std::string traceFile;   // Файл для трассы в формате Chrome Trace Event
+    bool bench = false;      // Серия замеров всех режимов обработки
+    BenchmarkOptions benchmark;
+    size_t top = 10;         // Сколько самых дорогих чеков показать
+    AffinityPolicy affinity = AffinityPolicy::None; // Закрепление потоков пула за процессорами
+};
+
+// Добавляет файл в список входных. Шаблон с *, ? или [ раскрывается в подходящие файлы
+// в порядке имён, так что файлы за разные дни идут по порядку. Возвращает false, если файл
+// не читается или по шаблону ничего не нашлось
+bool addInputs(std::vector<std::string>& inputs, const std::string& pattern) {
+    if (pattern.find_first_of("*?[") == std::string::npos) {
+        if (::access(pattern.c_str(), R_OK) != 0) {
+            std::cerr << "Не удалось открыть файл: " << pattern << "\n";
+            return false;
+        }
+        inputs.push_back(pattern);
+        return true;
+    }
+    glob_t matches;
+    if (::glob(pattern.c_str(), 0, nullptr, &matches) != 0) {
+        std::cerr << "Нет файлов по шаблону: " << pattern << "\n";
+        return false;
+    }
+    for (size_t i = 0; i < matches.gl_pathc; ++i) {
+        inputs.push_back(matches.gl_pathv[i]);
+    }
+    ::globfree(&matches);
+    return true;
+}
+
+// Номер чека из начала text; end — первый символ после числа
+inline bool parseReceiptId(const char* text, char*& end, int32_t& value) {
+    long long number = std::strtoll(text, &end, 10);
+    if (end == text || number < INT32_MIN || number > INT32_MAX) {
+        return false;
+    }
+    value = static_cast<int32_t>(number);
+    return true;
+}
 
-        // Добавляем данные в соответствующий чек
-        receiptsMap[id].id = id;
-        receiptsMap[id].products.push_back({name, price, quantity});
+// Диапазон --range: два номера через запятую (1000,2000) или один номер
+bool parseReceiptRange(const char* text, int32_t& from, int32_t& to) {
+    char* end;
+    if (!parseReceiptId(text, end, from)) {
+        return false;
     }
+    to = from;
+    if (*end == ',' && !parseReceiptId(end + 1, end, to)) {
+        return false;
+    }
+    return *end == '\0' && from <= to;
+}
 
-    // Переносим данные из карты в вектор
-    std::vector<Receipt> receipts;
-    for (auto& [_, receipt] : receiptsMap) {
-        receipts.push_back(std::move(receipt));
+// Целое число, занимающее всю строку text (std::from_chars: без пробелов и знака +)
+template <class T>
+bool parseNumber(std::string_view text, T& value) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+Options parseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        // Значение параметра из следующего аргумента; nullptr, если его нет
+        auto value = [&]() -> const char* {
+            if (i + 1 < argc) {
+                return argv[++i];
+            }
+            std::cerr << "Не указано значение параметра " << arg << "\n";
+            options.badOptions = true;
+            return nullptr;
+        };
+        // Целое значение параметра не меньше minimum
+        auto integer = [&](auto& target, long long minimum) {
+            const char* text = value();
+            std::remove_reference_t<decltype(target)> number;
+            if (text && (!parseNumber(text, number) || std::cmp_less(number, minimum))) {
+                std::cerr << "Неверное значение параметра " << arg << ": " << text << " (нужно целое число не меньше " << minimum << ")\n";
+                options.badOptions = true;
+            } else if (text) {
+                target = number;
+            }
+        };
+        if (arg == "--threads" || arg == "-t") {
+            integer(options.numThreads, 1);
+        } else if (arg == "--stream") {
+            options.stream = true;
+        } else if (arg == "--batch") {
+            integer(options.streamOptions.batchItems, 1);
+        } else if (arg == "--budget-mb") {
+            size_t megabytes = options.streamOptions.budgetBytes >> 20;
+            integer(megabytes, 1);
+            options.streamOptions.budgetBytes = megabytes << 20;
+        } else if (arg == "--convert") {
+            const char* file = value();
+            options.convertTo = file ? file : "";
+        } else if (arg == "--output" || arg == "-o") {
+            const char* file = value();
+            options.outputFile = file ? file : "";
+        } else if (arg == "--summary") {
+            options.outputMode = OutputMode::Summary;
+        } else if (arg == "--bench") {
+            options.bench = true;
+        } else if (arg == "--trials") {
+            integer(options.benchmark.trials, 1);
+        } else if (arg == "--warmup") {
+            integer(options.benchmark.warmup, 0);
+        } else if (arg == "--bench-threads") {
+            // Список через запятую: 1,2,4,8
+            const char* list = value();
+            std::string_view rest = list ? list : "";
+            while (list) {
+                std::string_view item = rest.substr(0, rest.find(','));
+                int threads = 0;
+                if (!parseNumber(item, threads) || threads < 1) {
+                    std::cerr << "Неверный список чисел потоков: " << list << " (нужно, например, 1,2,4)\n";
+                    options.badOptions = true;
+                    break;
+                }
+                options.benchmark.threads.push_back(threads);
+                if (item.size() == rest.size()) {
+                    break;
+                }
+                rest.remove_prefix(item.size() + 1);
+            }
+        } else if (arg == "--affinity") {
+            const char* text = value();
+            std::string policy = text ? text : "none";
+            if (policy == "compact") {
+                options.affinity = AffinityPolicy::Compact;
+            } else if (policy == "scatter") {
+                options.affinity = AffinityPolicy::Scatter;
+            } else if (policy == "node") {
+                options.affinity = AffinityPolicy::Node;
+            } else if (policy != "none") {
+                std::cerr << "Неизвестная политика закрепления: " << policy << "\n";
+                options.badOptions = true;
+            }
+        } else if (arg == "--csv") {
+            const char* file = value();
+            options.benchmark.csvFile = file ? file : "";
+        } else if (arg == "--profile") {
+            options.profile = true;
+        } else if (arg == "--counters") {
+            options.profile = true;
+            options.counters = true;
+        } else if (arg == "--trace") {
+            const char* file = value();
+            options.profile = true;
+            options.traceFile = file ? file : "";
+        } else if (arg == "--arena") {
+            options.arena = true;
+        } else if (arg == "--index") {
+            options.index = true;
+        } else if (arg == "--with") {
+            if (const char* name = value()) {
+                options.indexProducts.push_back(name);
+            }
+        } else if (arg == "--query") {
+            options.query = true;
+        } else if (arg == "--range") {
+            const char* range = i + 1 < argc ? argv[++i] : "";
+            if (!parseReceiptRange(range, options.rangeFrom, options.rangeTo)) {
+                std::cerr << "Неверный диапазон номеров чеков: \"" << range << "\" (нужно от,до или один номер, от <= до)\n";
+                options.badOptions = true;
+            }
+        } else if (arg == "--top") {
+            integer(options.top, 1);
+        } else if (arg == "--totals") {
+            options.totals = true;
+        } else if (arg == "--concurrent") {
+            options.concurrent = true;
+        } else if (arg == "--shards") {
+            integer(options.shards, 1);
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Неизвестный параметр: " << arg << "\n";
+            options.badOptions = true;
+        } else {
+            options.badInputs = !addInputs(options.inputs, arg) || options.badInputs;
+        }
+    }
+    if (options.inputs.empty() && !options.badInputs && !options.badOptions) {
+        options.badInputs = !addInputs(options.inputs, "receiptsUltraMini.txt");
     }
+    options.benchmark.affinity = options.affinity;
+    options.index = options.index || (!options.indexProducts.empty() && !options.query);
+    return options;
+}
+
+// Вывод времени этапов: вычисление, форматирование и запись результатов
+void printTimings(const std::string& title, double computeSeconds, const PrintStats& printStats) {
+    std::cout << title << ": " << computeSeconds << " секунд (форматирование: " << printStats.formatSeconds
+              << " секунд, вывод " << printStats.bytes << " байт: " << printStats.ioSeconds << " секунд)\n";
+}
 
-    return receipts;
+void printAllocations(const std::string& title, const AllocationStats& allocations) {
+    std::cout << "Выделений памяти (" << title << "): " << allocations.count << ", "
+              << allocations.bytes / (1024.0 * 1024.0) << " МБ\n";
 }
 
-int main() {
+// Профиль выводится при выходе из main из любой ветки: сводная таблица и, если задан файл, трасса
+struct ProfileReport {
+    const Options& options;
+
+    ~ProfileReport() {
+        if (!options.profile) {
+            return;
+        }
+        profiler.printSummary(std::cout);
+        if (!options.traceFile.empty() && profiler.writeTrace(options.traceFile)) {
+            std::cout << "Трасса записана в " << options.traceFile << "\n";
+        }
+    }
+};
+
+int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+    if (options.badOptions) {
+        std::cerr << usage;
+        return 1;
+    }
+    if (options.badInputs) {
+        return 1;
+    }
+    if (options.profile) {
+        profiler.enable(options.counters);
+    }
+    ThreadPool pool(options.numThreads); // Пул создаётся один раз и используется для загрузки и обработки
+    ProfileReport profileReport{options};
+    CpuTopology topology = CpuTopology::detect();
+    if (options.affinity != AffinityPolicy::None && !options.bench) {
+        if (!applyAffinity(pool, topology, options.affinity)) {
+            std::cerr << "Не удалось закрепить потоки за процессорами\n";
+        }
+        std::cout << "Закрепление потоков: " << affinityPolicyName(options.affinity) << ", узлов NUMA: "
+                  << topology.nodeCount() << ", процессоров: " << topology.cpus().size() << "\n";
+    }
+
+    // Результаты пишутся в стандартный вывод или в файл, если он указан
+    std::unique_ptr<OutputSink> sink;
+    if (options.outputFile.empty()) {
+        sink = std::make_unique<FdSink>();
+    } else {
+        sink = std::make_unique<FdSink>(options.outputFile);
+    }
+
+    if (options.stream) {
+        // Потоковый режим: чеки обрабатываются пакетами по мере чтения файла
+        ProductDictionary dictionary;
+        SalesProcessor processor(dictionary);
+        SalesAnalytics analytics;
+        if (options.query) {
+            processor.attachAnalytics(&analytics); // аналитика пополняется теми же пакетами
+        }
+        LoadStats streamStats;
+        {
+            ScopedPhase phase("потоковая обработка");
+            streamStats = streamReceiptsFromFiles(options.inputs, dictionary, processor, pool, options.streamOptions);
+        }
+        if (streamStats.failed) {
+            return 1;
+        }
+        if (options.query) {
+            std::cout << "Потоковая обработка с аналитикой (" << pool.size() << " потоков): ";
+            streamStats.print();
+            runAnalyticsQueries(dictionary, analytics, ReceiptView{}, options.indexProducts, options.top,
+                                options.rangeFrom, options.rangeTo);
+            std::cout << "Пиковое потребление памяти: " << peakMemoryMB() << " МБ\n";
+            return 0;
+        }
+        std::cout << std::endl;
+        PrintStats printStats;
+        {
+            ScopedPhase phase("вывод отчёта");
+            printStats = processor.printResults(*sink, pool, options.outputMode);
+        }
+        std::cout << "Потоковая обработка (" << pool.size() << " потоков): ";
+        streamStats.print();
+        printTimings("Вывод результатов", 0, printStats);
+        std::cout << "Пиковое потребление памяти: " << peakMemoryMB() << " МБ\n";
+        return 0;
+    }
+
+    // Загружаем данные о чеках из файла: названия товаров заменяются номерами из словаря.
+    // Двоичный файл только отображается в память, текстовый разбирается
+    LoadStats loadStats;
+    ProductDictionary dictionary;
+    ReceiptColumns columns;
+    ReceiptView items;
+    BinaryReceiptFile binary;
+    bool binaryInput = BinaryReceiptFile::isBinary(options.inputs.front());
+    if (options.inputs.size() > 1 && std::any_of(options.inputs.begin(), options.inputs.end(), BinaryReceiptFile::isBinary)) {
+        std::cerr << "Двоичный файл загружается только отдельно\n";
+        return 1;
+    }
+    auto loadStart = std::chrono::high_resolution_clock::now();
+    {
+        ScopedPhase phase("загрузка");
+        if (binaryInput) {
+            if (!binary.open(options.inputs.front(), dictionary)) {
+                std::cerr << "Файл повреждён: " << options.inputs.front() << "\n";
+                return 1;
+            }
+            items = binary.view();
+            if (!std::is_sorted(items.receiptId.begin(), items.receiptId.end())) {
+                columns = mergeByReceiptId(items, pool); // тот же порядок, что и у текстового файла
+                items = columns.view();
+            }
+            std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - loadStart;
+            loadStats = {binary.size(), distinctReceiptIds(items), items.size(), 0, duration.count()};
+        } else {
+            columns = loadReceiptColumns(options.inputs, dictionary, pool, &loadStats);
+            items = columns.view();
+        }
+    }
+    loadStats.print();
+    printAllocations("загрузка", AllocationStats::now());
+
+    if (!options.convertTo.empty()) {
+        // Конвертация текстового файла в двоичный формат
+        if (binaryInput) {
+            std::cerr << "Файл уже в двоичном формате\n";
+            return 1;
+        }
+        return saveReceiptsBinary(options.convertTo, dictionary, columns) ? 0 : 1;
+    }
+
+    if (options.bench) {
+        const std::string& first = options.inputs.front();
+        std::string dataset = first.substr(first.find_last_of('/') + 1);
+        if (options.inputs.size() > 1) {
+            dataset += "+" + std::to_string(options.inputs.size() - 1);
+        }
+        if (!binaryInput) {
+            options.benchmark.streamInputs = options.inputs;
+        }
+        return runBenchmark(dataset, dictionary, items, options.benchmark) ? 0 : 1;
+    }
+
+    // При закреплённых потоках позиции копируются так, чтобы фрагмент каждого потока лежал на его узле
+    PlacedColumns placed;
+    if (pool.isPinned()) {
+        ScopedPhase phase("размещение по узлам");
+        placed = PlacedColumns(items, pool);
+        items = placed.view();
+        columns = ReceiptColumns();
+    }
+
+    if (options.index) {
+        runIndexQueries(dictionary, items, pool, options.indexProducts, options.top);
+        return 0;
+    }
+
+    if (options.query) {
+        // Аналитика строится одним проходом по позициям, затем запросы к ней
+        SalesAnalytics analytics;
+        auto start = std::chrono::high_resolution_clock::now();
+        {
+            ScopedPhase phase("построение аналитики");
+            analytics.add(items);
+        }
+        std::chrono::duration<double> buildDuration = std::chrono::high_resolution_clock::now() - start;
+        std::cout << "Аналитика построена за " << buildDuration.count() << " секунд\n";
+        runAnalyticsQueries(dictionary, analytics, items, options.indexProducts, options.top, options.rangeFrom, options.rangeTo);
+        std::cout << "Пиковое потребление памяти: " << peakMemoryMB() << " МБ\n";
+        return 0;
+    }
+
+    if (options.totals) {
+        runTotalsKernels(dictionary, items, pool, *sink);
+        return 0;
+    }
 
+    if (options.concurrent) {
+        runConcurrentBenchmark(dictionary, items, pool, options.shards);
+        return 0;
+    }
 
-    // Загружаем данные о чеках из файла
-    std::vector<Receipt> receipts = loadReceiptsFromFile("receiptsUltraMini.txt");
+    // С --arena результаты обработки размещаются в арене и освобождаются одним разом в конце
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::memory_resource* resource = options.arena ? &arena : std::pmr::get_default_resource();
 
-    SalesProcessor processor(receipts);
+    AllocationStats allocationsBefore = AllocationStats::now();
+    SalesProcessor processor(dictionary, items, resource);
 
-    // Измерение времени для однопоточной обработки
+    // Измерение времени для однопоточной обработки (вывод результатов замеряется отдельно)
     auto start = std::chrono::high_resolution_clock::now();
-    processor.processSingleThread();
+    {
+        ScopedPhase phase("однопоточная обработка");
+        processor.processSingleThread();
+    }
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> singleThreadDuration = end - start;
+    AllocationStats singleAllocations = AllocationStats::now().since(allocationsBefore);
+    std::cout << std::endl;
+    PrintStats singlePrint;
+    {
+        ScopedPhase phase("вывод отчёта");
+        singlePrint = processor.printResults(*sink, pool, options.outputMode);
+    }
 
     // Вывод времени однопоточной обработки
-    std::cout << "Время однопоточной обработки: " << singleThreadDuration.count() << " секунд\n";
+    printTimings("Время однопоточной обработки", singleThreadDuration.count(), singlePrint);
+    printAllocations("однопоточная обработка", singleAllocations);
 
     // Обнуление результатов для многопоточной обработки
-    SalesProcessor multiThreadProcessor(receipts);
+    allocationsBefore = AllocationStats::now();
+    SalesProcessor multiThreadProcessor(dictionary, items, resource);
 
     // Измерение времени для многопоточной обработки
-    int numThreads = 4; // Количество потоков
     start = std::chrono::high_resolution_clock::now();
-    multiThreadProcessor.processMultiThread(numThreads);
+    {
+        ScopedPhase phase("многопоточная обработка");
+        multiThreadProcessor.processMultiThread(pool);
+    }
     end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> multiThreadDuration = end - start;
+    AllocationStats multiAllocations = AllocationStats::now().since(allocationsBefore);
+    std::cout << std::endl;
+    PrintStats multiPrint;
+    {
+        ScopedPhase phase("вывод отчёта");
+        multiPrint = multiThreadProcessor.printResults(*sink, pool, options.outputMode);
+    }
 
     // Вывод времени многопоточной обработки
-    std::cout << "Время многопоточной обработки: " << multiThreadDuration.count() << " секунд\n";
+    printTimings("Время многопоточной обработки (" + std::to_string(pool.size()) + " потоков)", multiThreadDuration.count(), multiPrint);
+    if (pool.isPinned()) {
+        std::cout << "Пропускная способность по узлам: "
+                  << nodeThroughput(pool, multiThreadProcessor.itemsPerWorker(), multiThreadDuration.count()) << "\n";
+    }
+    printAllocations("многопоточная обработка", multiAllocations);
+    std::cout << "Пиковое потребление памяти: " << peakMemoryMB() << " МБ\n";
 
     return 0;
 }
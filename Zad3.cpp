@@ -2,47 +2,211 @@
 #include <thread>
 #include <mutex>
 #include <chrono>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <ratio>
+#include <type_traits>
+#include <utility>
+#include <coroutine>
+#include <charconv>
+#include <initializer_list>
+#include <functional>
+
+#include "Runtime.h"
 
 using namespace std;
 
+// Растущий массив, хранящий элементы прямо в своём буфере (в том числе перемещаемые,
+// но не копируемые, например thread). Первые InlineCapacity элементов живут внутри
+// самого объекта без выделения памяти; дальше ёмкость растёт в Growth раз (std::ratio).
+// При росте элементы переносятся: тривиально копируемые — одним memcpy, остальные —
+// перемещением (копированием, если перемещение может бросить исключение)
+template <typename T, size_t InlineCapacity = 0, typename Growth = ratio<2>>
 class MyVector {
+    static_assert(Growth::num > Growth::den, "коэффициент роста должен быть больше 1");
+
 public: // можно использовать в любой точке кода
-    MyVector() : size_(0), capacity_(1) { // конструктор - инициализация
-        data_ = new thread * [capacity_];
+    MyVector() : data_(inline_data()), size_(0), capacity_(InlineCapacity) {} // конструктор - инициализация
+
+    ~MyVector() { //деструктор - уничтожение элементов и освобожденине памяти
+        clear();
+        deallocate(data_, capacity_);
     }
 
-    ~MyVector() { //деструктор - освобожденине памяти
-        delete[] data_;
+    // Перенос встроенного буфера создаёт элементы заново, поэтому перемещение MyVector
+    // не бросает исключений, только если их не бросает перемещение T (или буфера нет)
+    MyVector(MyVector&& other) noexcept(nothrow_take) : MyVector() {
+        take(other);
     }
 
-    void push_back(thread* t) { //добавление в конец массива
-        if (size_ >= capacity_) {
-            resize();
+    MyVector& operator=(MyVector&& other) noexcept(nothrow_take) {
+        if (this != &other) {
+            clear();
+            deallocate(data_, capacity_);
+            data_ = inline_data();
+            capacity_ = InlineCapacity;
+            take(other);
         }
-        data_[size_++] = t;
+        return *this;
     }
 
-    thread* operator[](size_t index) { //доступ к элементу
-        return data_[index];
+    MyVector(const MyVector&) = delete;
+    MyVector& operator=(const MyVector&) = delete;
+
+    // Выделяет память сразу под capacity элементов
+    void reserve(size_t capacity) {
+        if (capacity > capacity_) {
+            reallocate(capacity);
+        }
     }
 
-    size_t size() const { //узнать размер массива
-        return size_;
+    // Создаёт элемент на месте в конце массива
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (size_ < capacity_) {
+            new (data_ + size_) T(forward<Args>(args)...);
+            return data_[size_++];
+        }
+        // Новый элемент создаётся в новом буфере до переноса старых: аргументы могут
+        // ссылаться на элементы массива, а при исключении старый буфер остаётся целым
+        size_t capacity = grown_capacity();
+        T* data = allocate(capacity);
+        try {
+            new (data + size_) T(forward<Args>(args)...);
+        } catch (...) {
+            deallocate(data, capacity);
+            throw;
+        }
+        try {
+            relocate(data_, size_, data);
+        } catch (...) {
+            data[size_].~T();
+            deallocate(data, capacity);
+            throw;
+        }
+        deallocate(data_, capacity_);
+        data_ = data;
+        capacity_ = capacity;
+        return data_[size_++];
     }
 
+    void push_back(const T& value) { emplace_back(value); } //добавление в конец массива
+    void push_back(T&& value) { emplace_back(move(value)); }
+
+    void pop_back() {
+        data_[--size_].~T();
+    }
+
+    void clear() {
+        destroy(data_, size_);
+        size_ = 0;
+    }
+
+    T& operator[](size_t index) { return data_[index]; } //доступ к элементу
+    const T& operator[](size_t index) const { return data_[index]; }
+    T& back() { return data_[size_ - 1]; }
+
+    T* begin() { return data_; }
+    T* end() { return data_ + size_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    T* data() { return data_; }
+
+    size_t size() const { return size_; } //узнать размер массива
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return size_ == 0; }
+    bool is_inline() const { return data_ == inline_data(); } // элементы во встроенном буфере
+
 private: // использование только внутри класса
-    thread** data_; //указатель на массив указателей (потоки)
+    static constexpr bool nothrow_take = InlineCapacity == 0 || is_nothrow_move_constructible_v<T>;
+
+    T* data_; // указатель на элементы: встроенный буфер или выделенная память
     size_t size_; //размер
     size_t capacity_;//емкость
+    alignas(T) unsigned char inline_[InlineCapacity > 0 ? InlineCapacity * sizeof(T) : 1]; // встроенный буфер
+
+    T* inline_data() { return reinterpret_cast<T*>(inline_); }
+    const T* inline_data() const { return reinterpret_cast<const T*>(inline_); }
+
+    size_t grown_capacity() const {
+        return max(capacity_ + 1, static_cast<size_t>(capacity_ * Growth::num / Growth::den));
+    }
+
+    T* allocate(size_t capacity) {
+        return static_cast<T*>(::operator new(capacity * sizeof(T), align_val_t(alignof(T))));
+    }
 
-    void resize() { // метод увеличение емкости массива
-        capacity_ *= 2;
-        thread** new_data = new thread * [capacity_];
-        for (size_t i = 0; i < size_; ++i) {
-            new_data[i] = data_[i];
+    void deallocate(T* data, size_t capacity) {
+        if (data != inline_data()) {
+            ::operator delete(data, capacity * sizeof(T), align_val_t(alignof(T)));
         }
-        delete[] data_;
-        data_ = new_data;
+    }
+
+    static void destroy(T* data, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            data[i].~T();
+        }
+    }
+
+    // Переносит count элементов в неинициализированную память to. Старые элементы
+    // уничтожаются только после того, как созданы все новые: если копирование бросит
+    // исключение, созданная часть уничтожается, а исходные элементы остаются целыми
+    static void relocate(T* from, size_t count, T* to) {
+        if constexpr (is_trivially_copyable_v<T>) {
+            if (count > 0) {
+                memcpy(static_cast<void*>(to), from, count * sizeof(T));
+            }
+        } else {
+            size_t built = 0;
+            try {
+                for (; built < count; ++built) {
+                    new (to + built) T(move_if_noexcept(from[built]));
+                }
+            } catch (...) {
+                destroy(to, built);
+                throw;
+            }
+            destroy(from, count);
+        }
+    }
+
+    void reallocate(size_t capacity) { // метод увеличение емкости массива
+        T* data = allocate(capacity);
+        try {
+            relocate(data_, size_, data);
+        } catch (...) {
+            deallocate(data, capacity);
+            throw;
+        }
+        deallocate(data_, capacity_);
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    // Забирает элементы other: выделенный буфер передаётся целиком, встроенный переносится
+    void take(MyVector& other) {
+        if (other.is_inline()) {
+            relocate(other.data_, other.size_, data_);
+        } else {
+            data_ = other.data_;
+            capacity_ = other.capacity_;
+            other.data_ = other.inline_data();
+            other.capacity_ = InlineCapacity;
+        }
+        size_ = other.size_;
+        other.size_ = 0;
     }
 };
 
@@ -84,16 +248,914 @@ void philosopher(int id) {
     }
 }
 
-int main() {
-    MyVector philosophers; // вектор с философами 
+// ---------------------------------------------------------------------------
+// Симуляция обедающих философов для сравнения стратегий захвата нескольких ресурсов:
+// N философов и N вилок, настраиваемое время размышления и еды (можно 0), ограничение
+// по времени или по числу обедов. Запуск: ./zad3 --strategy all --philosophers 1000 ...
+// ---------------------------------------------------------------------------
+
+constexpr size_t cache_line = 64;
+
+// Стратегия захвата вилок: философ id пользуется вилками id (левая) и (id + 1) % n (правая)
+class ForkStrategy {
+public:
+    virtual ~ForkStrategy() = default;
+    virtual void acquire(int id) = 0; // Взять обе вилки (блокирует, пока не получится)
+    virtual void release(int id) = 0; // Положить обе вилки
+};
+
+// Вилка-мьютекс на отдельной кеш-линии, чтобы соседние вилки не делили линию
+struct alignas(cache_line) ForkMutex {
+    mutex m;
+};
+
+// Исходная стратегия: сначала вилка с меньшим номером, потом с большим.
+// Общий порядок захвата исключает циклическое ожидание
+class OrderedStrategy : public ForkStrategy {
+public:
+    explicit OrderedStrategy(int n) : n(n), forks(n) {}
+
+    void acquire(int id) override {
+        forks[min(id, (id + 1) % n)].m.lock();
+        forks[max(id, (id + 1) % n)].m.lock();
+    }
+
+    void release(int id) override {
+        forks[max(id, (id + 1) % n)].m.unlock();
+        forks[min(id, (id + 1) % n)].m.unlock();
+    }
+
+private:
+    int n;
+    vector<ForkMutex> forks;
+};
+
+// Официант (арбитр): философ просит разрешения, и официант выдаёт обе вилки сразу,
+// только если обе свободны. Все решения принимаются под одним мьютексом, поэтому
+// стратегия проста, но официант становится узким местом при большом числе философов.
+// У каждого философа своя условная переменная: будятся только соседи освободившего вилки
+class WaiterStrategy : public ForkStrategy {
+public:
+    explicit WaiterStrategy(int n) : n(n), busy(n, 0), wake(new condition_variable[n]) {}
+
+    void acquire(int id) override {
+        unique_lock<mutex> lock(m);
+        int left = id;
+        int right = (id + 1) % n;
+        wake[id].wait(lock, [&]() { return !busy[left] && !busy[right]; });
+        busy[left] = busy[right] = 1;
+    }
+
+    void release(int id) override {
+        {
+            lock_guard<mutex> lock(m);
+            busy[id] = busy[(id + 1) % n] = 0;
+        }
+        wake[(id + n - 1) % n].notify_one(); // сосед слева ждёт вилку id
+        wake[(id + 1) % n].notify_one();     // сосед справа ждёт вилку id + 1
+    }
+
+private:
+    int n;
+    mutex m;
+    vector<char> busy; // Занята ли вилка
+    unique_ptr<condition_variable[]> wake;
+};
+
+// Алгоритм Чанди–Мисры: у каждой вилки есть владелец, и она бывает чистой или грязной.
+// Голодный философ просит недостающую вилку у соседа; сосед отдаёт грязную вилку сразу
+// (очистив её), а чистую оставляет себе, пока не поест. После еды вилки становятся грязными,
+// и запрошенные передаются соседям. Вначале все вилки грязные и принадлежат философу
+// с меньшим номером — граф приоритетов ацикличен, поэтому нет ни взаимной блокировки,
+// ни голодания. Сообщения «запрос» и «передача» здесь — поля вилки под её мьютексом:
+// обработчик запроса к философу, который не ест, выполняет сам запрашивающий
+class ChandyMisraStrategy : public ForkStrategy {
+public:
+    explicit ChandyMisraStrategy(int n) : n(n), forks(n) {
+        for (int f = 0; f < n; ++f) {
+            forks[f].owner = f == 0 ? 0 : f - 1; // вилку f делят философы f - 1 и f
+        }
+    }
+
+    void acquire(int id) override {
+        Fork& left = forks[id];
+        Fork& right = forks[(id + 1) % n];
+        while (true) {
+            unique_lock<mutex> left_lock(left.m, defer_lock);
+            unique_lock<mutex> right_lock(right.m, defer_lock);
+            lock(left_lock, right_lock);
+            take_if_dirty(left, id);
+            take_if_dirty(right, id);
+            if (left.owner == id && right.owner == id) {
+                left.eating = right.eating = true; // с этого момента вилки не отдаются
+                return;
+            }
+            // Ждём недостающую вилку, не удерживая мьютекс второй
+            bool wait_left = left.owner != id;
+            Fork& missing = wait_left ? left : right;
+            unique_lock<mutex>& missing_lock = wait_left ? left_lock : right_lock;
+            (wait_left ? right_lock : left_lock).unlock();
+            missing.requested = true;
+            missing.cv.wait(missing_lock, [&]() { return missing.owner == id || (!missing.eating && missing.dirty); });
+        }
+    }
+
+    void release(int id) override {
+        hand_over(forks[id], (id + n - 1) % n);
+        hand_over(forks[(id + 1) % n], (id + 1) % n);
+    }
+
+private:
+    struct alignas(cache_line) Fork {
+        mutex m;
+        condition_variable cv;
+        int owner = 0;
+        bool dirty = true;      // Вначале все вилки грязные
+        bool eating = false;    // Владелец ест этой вилкой
+        bool requested = false; // Сосед владельца ждёт эту вилку
+    };
+
+    // Обработка запроса: владелец, который не ест, отдаёт грязную вилку, очистив её
+    static void take_if_dirty(Fork& fork, int id) {
+        if (fork.owner != id && !fork.eating && fork.dirty) {
+            fork.owner = id;
+            fork.dirty = false;
+            fork.requested = false;
+        }
+    }
+
+    // После еды вилка грязная; если её ждут — передаётся соседу чистой
+    static void hand_over(Fork& fork, int neighbor) {
+        {
+            lock_guard<mutex> lock(fork.m);
+            fork.eating = false;
+            fork.dirty = true;
+            if (!fork.requested) {
+                return;
+            }
+            fork.owner = neighbor;
+            fork.dirty = false;
+            fork.requested = false;
+        }
+        fork.cv.notify_all();
+    }
+
+    int n;
+    vector<Fork> forks;
+};
+
+// Попытка с отступлением: берём одну вилку, пробуем взять вторую (try_lock); если не вышло —
+// кладём первую, ждём случайное время с экспоненциальным ростом и начинаем с другой вилки.
+// Взаимной блокировки нет, но возможны холостые попытки и голодание
+class TryLockStrategy : public ForkStrategy {
+public:
+    explicit TryLockStrategy(int n) : n(n), forks(n) {}
+
+    void acquire(int id) override {
+        int first = id;
+        int second = (id + 1) % n;
+        int delay_us = 1;
+        thread_local minstd_rand random(static_cast<unsigned>(hash<thread::id>()(this_thread::get_id())));
+        for (int attempt = 0;; ++attempt) {
+            forks[first].m.lock();
+            if (forks[second].m.try_lock()) {
+                return;
+            }
+            forks[first].m.unlock();
+            swap(first, second);
+            if (attempt < 4) {
+                this_thread::yield(); // короткие конфликты разрешаются уступкой процессора
+            } else {
+                this_thread::sleep_for(chrono::microseconds(random() % delay_us + 1));
+                delay_us = min(delay_us * 2, max_delay_us);
+            }
+        }
+    }
+
+    void release(int id) override {
+        forks[id].m.unlock();
+        forks[(id + 1) % n].m.unlock();
+    }
+
+private:
+    static constexpr int max_delay_us = 1000;
+
+    int n;
+    vector<ForkMutex> forks;
+};
+
+// Те же стратегии для сопрограмм: философ ждёт вилки, приостанавливаясь, а не занимая
+// поток ОС, поэтому философов может быть сотни тысяч на нескольких рабочих потоках
+
+class CoroOrderedStrategy {
+public:
+    explicit CoroOrderedStrategy(int n) : n(n), forks(n) {}
+
+    coro::Task acquire(int id) {
+        co_await forks[min(id, (id + 1) % n)].lock();
+        co_await forks[max(id, (id + 1) % n)].lock();
+    }
+
+    void release(int id) {
+        forks[max(id, (id + 1) % n)].unlock();
+        forks[min(id, (id + 1) % n)].unlock();
+    }
+
+private:
+    int n;
+    vector<coro::AsyncMutex> forks;
+};
+
+// Официант: голодный философ, которому нельзя есть, оставляет официанту свою сопрограмму,
+// и тот запускает её, когда сосед освободит вилки
+class CoroWaiterStrategy {
+public:
+    explicit CoroWaiterStrategy(int n) : n(n), busy(n, 0), waiting(n) {}
+
+    auto acquire(int id) {
+        struct Ask {
+            CoroWaiterStrategy& waiter;
+            int id;
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(coroutine_handle<> handle) {
+                lock_guard<mutex> lock(waiter.m);
+                if (waiter.try_grant(id)) {
+                    return false;
+                }
+                waiter.waiting[id] = handle;
+                return true;
+            }
+            void await_resume() const noexcept {}
+        };
+        return Ask{*this, id};
+    }
+
+    void release(int id) {
+        coroutine_handle<> ready[2];
+        int count = 0;
+        {
+            lock_guard<mutex> lock(m);
+            busy[id] = busy[(id + 1) % n] = 0;
+            for (int neighbor : {(id + n - 1) % n, (id + 1) % n}) {
+                if (waiting[neighbor] && try_grant(neighbor)) {
+                    ready[count++] = exchange(waiting[neighbor], nullptr);
+                }
+            }
+        }
+        for (int i = 0; i < count; ++i) {
+            coro::Scheduler::current().schedule(ready[i]);
+        }
+    }
+
+private:
+    bool try_grant(int id) {
+        if (busy[id] || busy[(id + 1) % n]) {
+            return false;
+        }
+        busy[id] = busy[(id + 1) % n] = 1;
+        return true;
+    }
+
+    int n;
+    mutex m;
+    vector<char> busy;
+    vector<coroutine_handle<>> waiting; // Философ, ждущий разрешения официанта
+};
+
+// Чанди–Миса: как ChandyMisraStrategy, но запросившая вилку сопрограмма ждёт
+// в поле вилки, и передающий вилку сосед сам ставит её в очередь планировщика
+class CoroChandyMisraStrategy {
+public:
+    explicit CoroChandyMisraStrategy(int n) : n(n), forks(n) {
+        for (int f = 0; f < n; ++f) {
+            forks[f].owner = f == 0 ? 0 : f - 1;
+        }
+    }
+
+    coro::Task acquire(int id) {
+        Fork& left = forks[id];
+        Fork& right = forks[(id + 1) % n];
+        while (true) {
+            Fork* missing;
+            {
+                scoped_lock lock(left.m, right.m);
+                take_if_dirty(left, id);
+                take_if_dirty(right, id);
+                if (left.owner == id && right.owner == id) {
+                    left.eating = right.eating = true;
+                    co_return;
+                }
+                missing = left.owner != id ? &left : &right;
+                missing->requested = true;
+            }
+            co_await WaitFork{*missing, id};
+        }
+    }
+
+    void release(int id) {
+        hand_over(forks[id], (id + n - 1) % n);
+        hand_over(forks[(id + 1) % n], (id + 1) % n);
+    }
+
+private:
+    struct alignas(cache_line) Fork {
+        mutex m;
+        int owner = 0;
+        bool dirty = true;
+        bool eating = false;
+        bool requested = false;
+        coroutine_handle<> waiter; // Сосед, ждущий эту вилку
+    };
+
+    struct WaitFork {
+        Fork& fork;
+        int id;
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(coroutine_handle<> handle) {
+            lock_guard<mutex> lock(fork.m);
+            if (fork.owner == id || (!fork.eating && fork.dirty)) {
+                return false; // вилку уже передали или её можно забрать
+            }
+            fork.waiter = handle;
+            return true;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    static void take_if_dirty(Fork& fork, int id) {
+        if (fork.owner != id && !fork.eating && fork.dirty) {
+            fork.owner = id;
+            fork.dirty = false;
+            fork.requested = false;
+        }
+    }
+
+    static void hand_over(Fork& fork, int neighbor) {
+        coroutine_handle<> waiter;
+        {
+            lock_guard<mutex> lock(fork.m);
+            fork.eating = false;
+            fork.dirty = true;
+            if (!fork.requested) {
+                return;
+            }
+            fork.owner = neighbor;
+            fork.dirty = false;
+            fork.requested = false;
+            waiter = exchange(fork.waiter, nullptr);
+        }
+        if (waiter) {
+            coro::Scheduler::current().schedule(waiter);
+        }
+    }
+
+    int n;
+    vector<Fork> forks;
+};
+
+// Попытка с отступлением: отступление — сон на таймере планировщика. Генератор у каждого
+// философа свой: сопрограмма может продолжиться на другом потоке, thread_local не годится
+class CoroTryLockStrategy {
+public:
+    explicit CoroTryLockStrategy(int n) : n(n), forks(n), randoms(n) {
+        for (int id = 0; id < n; ++id) {
+            randoms[id].seed(id + 1);
+        }
+    }
+
+    coro::Task acquire(int id) {
+        int first = id;
+        int second = (id + 1) % n;
+        int delay_us = 1;
+        for (int attempt = 0;; ++attempt) {
+            co_await forks[first].lock();
+            if (forks[second].try_lock()) {
+                co_return;
+            }
+            forks[first].unlock();
+            swap(first, second);
+            if (attempt < 4) {
+                co_await coro::yield();
+            } else {
+                co_await coro::sleep_for(chrono::microseconds(randoms[id]() % delay_us + 1));
+                delay_us = min(delay_us * 2, max_delay_us);
+            }
+        }
+    }
+
+    void release(int id) {
+        forks[id].unlock();
+        forks[(id + 1) % n].unlock();
+    }
+
+private:
+    static constexpr int max_delay_us = 1000;
+
+    int n;
+    vector<coro::AsyncMutex> forks;
+    vector<minstd_rand> randoms;
+};
+
+unique_ptr<ForkStrategy> make_strategy(const string& name, int n) {
+    if (name == "ordered") {
+        return make_unique<OrderedStrategy>(n);
+    }
+    if (name == "waiter") {
+        return make_unique<WaiterStrategy>(n);
+    }
+    if (name == "chandy-misra") {
+        return make_unique<ChandyMisraStrategy>(n);
+    }
+    if (name == "trylock") {
+        return make_unique<TryLockStrategy>(n);
+    }
+    return nullptr;
+}
+
+// Параметры симуляции
+struct SimOptions {
+    vector<string> strategies = {"ordered", "waiter", "chandy-misra", "trylock"};
+    int philosophers = 5;
+    int think_us = 0;      // Время размышления, мкс
+    int eat_us = 0;        // Время еды, мкс
+    int duration_ms = 1000; // Длительность прогона (если не задано число обедов)
+    long meals = 0;        // Обедов на философа; 0 — ограничение по времени
+    bool coroutines = false; // Философы — сопрограммы на планировщике, а не потоки
+    int workers = max(1, static_cast<int>(thread::hardware_concurrency())); // Рабочих потоков планировщика
+    string csv_file;       // Куда сохранить результаты в CSV
+    bool valid = true;     // Ложь, если в командной строке есть ошибка
+};
+
+// Статистика философа: у каждого своя, на отдельной кеш-линии
+struct alignas(cache_line) PhilosopherStats {
+    long meals = 0;
+    uint64_t max_wait_ns = 0;
+    vector<uint64_t> waits; // Ожидание вилок в каждом обеде, нс
+};
+
+// Итоги прогона одной стратегии
+struct SimResult {
+    string strategy;
+    string runtime;          // "threads" или "coroutines"
+    int philosophers = 0;
+    long meals = 0;          // Обедов всего
+    double seconds = 0;
+    double meals_per_sec = 0;
+    double jain = 0;         // Индекс справедливости Джайна по числу обедов (1 — поровну)
+    long min_meals = 0;      // Меньше всего обедов у одного философа
+    long max_meals = 0;
+    uint64_t max_wait_ns = 0; // Самое долгое ожидание вилок (голодание)
+    uint64_t p50_ns = 0;     // Перцентили ожидания вилок
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    double switches_per_sec = 0; // Переключений контекста в секунду (ОС и планировщика)
+    double bytes_per_actor = 0;  // Память на философа: стек потока или кадр сопрограммы
+};
+
+void pause_for(int us) {
+    if (us > 0) {
+        this_thread::sleep_for(chrono::microseconds(us));
+    }
+}
+
+// Итоги прогона по статистике философов
+SimResult summarize(const string& name, vector<PhilosopherStats>& stats, double seconds) {
+    int n = static_cast<int>(stats.size());
+    SimResult result;
+    result.strategy = name;
+    result.philosophers = n;
+    result.seconds = seconds;
+    result.min_meals = stats[0].meals;
+    double sum = 0;
+    double sum_squares = 0;
+    vector<uint64_t> waits;
+    for (const PhilosopherStats& s : stats) {
+        result.meals += s.meals;
+        result.min_meals = min(result.min_meals, s.meals);
+        result.max_meals = max(result.max_meals, s.meals);
+        result.max_wait_ns = max(result.max_wait_ns, s.max_wait_ns);
+        sum += s.meals;
+        sum_squares += static_cast<double>(s.meals) * s.meals;
+        waits.insert(waits.end(), s.waits.begin(), s.waits.end());
+    }
+    result.meals_per_sec = result.seconds > 0 ? result.meals / result.seconds : 0;
+    result.jain = sum_squares > 0 ? sum * sum / (n * sum_squares) : 0;
+    if (!waits.empty()) {
+        auto percentile = [&](double p) {
+            size_t k = min(waits.size() - 1, static_cast<size_t>(p * (waits.size() - 1)));
+            nth_element(waits.begin(), waits.begin() + k, waits.end());
+            return waits[k];
+        };
+        result.p50_ns = percentile(0.5);
+        result.p99_ns = percentile(0.99);
+        result.p999_ns = percentile(0.999);
+    }
+    return result;
+}
+
+
+// Поток на философа: память замеряется, когда созданы все потоки, переключения — по счётчикам ОС
+SimResult simulate_threads(const string& name, const SimOptions& options) {
+    int n = options.philosophers;
+    unique_ptr<ForkStrategy> strategy = make_strategy(name, n);
+    vector<PhilosopherStats> stats(n);
+    atomic<bool> stop{false};
+    atomic<int> ready{0};
+    atomic<bool> go{false};
+
+    long long rss_before = coro::resident_bytes();
+    MyVector<thread> threads;
+    threads.reserve(n);
+    for (int id = 0; id < n; ++id) {
+        threads.emplace_back([&, id]() {
+            PhilosopherStats& my = stats[id];
+            ready.fetch_add(1);
+            while (!go.load(memory_order_acquire)) {
+                this_thread::yield();
+            }
+            while (!stop.load(memory_order_relaxed) && (options.meals == 0 || my.meals < options.meals)) {
+                pause_for(options.think_us); // размышляет
+                auto hungry = chrono::steady_clock::now();
+                strategy->acquire(id);
+                uint64_t wait = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - hungry).count();
+                pause_for(options.eat_us); // ест
+                strategy->release(id);
+                ++my.meals;
+                my.max_wait_ns = max(my.max_wait_ns, wait);
+                my.waits.push_back(wait);
+            }
+        });
+    }
+    while (ready.load() != n) {
+        this_thread::yield();
+    }
+
+    long long rss_peak = coro::resident_bytes();
+    long long switches_before = coro::os_context_switches();
+    auto start = chrono::steady_clock::now();
+    go.store(true, memory_order_release);
+    if (options.meals == 0) {
+        this_thread::sleep_for(chrono::milliseconds(options.duration_ms));
+        stop.store(true, memory_order_relaxed);
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    chrono::duration<double> duration = chrono::steady_clock::now() - start;
+
+    SimResult result = summarize(name, stats, duration.count());
+    result.runtime = "threads";
+    result.switches_per_sec = (coro::os_context_switches() - switches_before) / result.seconds;
+    result.bytes_per_actor = static_cast<double>(rss_peak - rss_before) / n;
+    return result;
+}
+
+// Философ-сопрограмма: размышляет и ест на таймере, вилки ждёт приостановкой
+template <typename Strategy>
+coro::Actor coro_philosopher(Strategy& strategy, int id, const SimOptions& options, const atomic<bool>& stop, PhilosopherStats& my) {
+    while (!stop.load(memory_order_relaxed) && (options.meals == 0 || my.meals < options.meals)) {
+        if (options.think_us > 0) {
+            co_await coro::sleep_for(chrono::microseconds(options.think_us)); // размышляет
+        } else {
+            co_await coro::yield(); // без паузы философ не отдал бы поток остальным
+        }
+        auto hungry = chrono::steady_clock::now();
+        co_await strategy.acquire(id);
+        uint64_t wait = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - hungry).count();
+        if (options.eat_us > 0) {
+            co_await coro::sleep_for(chrono::microseconds(options.eat_us)); // ест
+        }
+        strategy.release(id);
+        ++my.meals;
+        my.max_wait_ns = max(my.max_wait_ns, wait);
+        my.waits.push_back(wait);
+    }
+}
+
+// Сопрограмма на философа: память на философа — размер его кадра, переключения —
+// запуски сопрограмм планировщиком плюс переключения потоков ОС
+template <typename Strategy>
+SimResult simulate_coroutines_with(const string& name, const SimOptions& options) {
+    int n = options.philosophers;
+    Strategy strategy(n);
+    vector<PhilosopherStats> stats(n);
+    atomic<bool> stop{false};
+    coro::Scheduler scheduler(options.workers);
+
+    long long frames_before = coro::frame_bytes.load();
+    MyVector<coro::Actor> actors;
+    actors.reserve(n);
+    for (int id = 0; id < n; ++id) {
+        actors.emplace_back(coro_philosopher(strategy, id, options, stop, stats[id]));
+    }
+    long long frames_peak = coro::frame_bytes.load();
+
+    long long switches_before = coro::os_context_switches();
+    uint64_t resumes_before = scheduler.switches();
+    auto start = chrono::steady_clock::now();
+    for (coro::Actor& actor : actors) {
+        scheduler.spawn(move(actor));
+    }
+    if (options.meals == 0) {
+        this_thread::sleep_for(chrono::milliseconds(options.duration_ms));
+        stop.store(true, memory_order_relaxed);
+    }
+    scheduler.wait_all();
+    chrono::duration<double> duration = chrono::steady_clock::now() - start;
+
+    SimResult result = summarize(name, stats, duration.count());
+    result.runtime = "coroutines";
+    result.switches_per_sec = (scheduler.switches() - resumes_before + coro::os_context_switches() - switches_before) / result.seconds;
+    result.bytes_per_actor = static_cast<double>(frames_peak - frames_before) / n;
+    return result;
+}
+
+SimResult simulate(const string& name, const SimOptions& options) {
+    if (!options.coroutines) {
+        return simulate_threads(name, options);
+    }
+    if (name == "ordered") {
+        return simulate_coroutines_with<CoroOrderedStrategy>(name, options);
+    }
+    if (name == "waiter") {
+        return simulate_coroutines_with<CoroWaiterStrategy>(name, options);
+    }
+    if (name == "chandy-misra") {
+        return simulate_coroutines_with<CoroChandyMisraStrategy>(name, options);
+    }
+    return simulate_coroutines_with<CoroTryLockStrategy>(name, options);
+}
+
+// Разбор целого числа: строка должна быть числом целиком и не меньше minimum
+template <class T>
+bool parse_number(const string& text, T& value, T minimum) {
+    T result{};
+    auto [end, error] = from_chars(text.data(), text.data() + text.size(), result);
+    if (error != errc() || end != text.data() + text.size() || result < minimum) {
+        return false;
+    }
+    value = result;
+    return true;
+}
+
+// Разбор параметров вида "--имя значение", начиная с argv[first]. Обработчик параметра разбирает
+// значение и возвращает false, если оно неверное. Ошибки печатаются в cerr; результат — не было ли их
+bool parse_option_list(int argc, char* argv[], int first, initializer_list<pair<const char*, function<bool(const string&)>>> handlers) {
+    bool valid = true;
+    for (int i = first; i < argc; ++i) {
+        string arg = argv[i];
+        auto handler = find_if(handlers.begin(), handlers.end(), [&](const auto& h) { return arg == h.first; });
+        if (handler == handlers.end()) {
+            cerr << "Неизвестный параметр: " << arg << endl;
+            valid = false;
+        } else if (i + 1 >= argc) {
+            cerr << "Не указано значение параметра " << arg << endl;
+            valid = false;
+        } else if (!handler->second(argv[++i])) {
+            cerr << "Неверное значение параметра " << arg << ": " << argv[i] << endl;
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+const char* const sim_usage =
+    "Использование: zad3 [--strategy all|ordered|waiter|chandy-misra|trylock] [--philosophers N]\n"
+    "                    [--think-us N] [--eat-us N] [--duration-ms N | --meals N]\n"
+    "                    [--runtime threads|coroutines] [--workers N] [--csv файл]\n";
+
+SimOptions parse_sim_options(int argc, char* argv[]) {
+    SimOptions options;
+    options.valid = parse_option_list(argc, argv, 1, {
+        {"--strategy", [&](const string& name) {
+            if (name != "all") {
+                options.strategies = {name};
+            }
+            return name == "all" || make_strategy(name, 2) != nullptr;
+        }},
+        // С одной вилкой на двоих задача теряет смысл
+        {"--philosophers", [&](const string& v) { return parse_number(v, options.philosophers, 2); }},
+        {"--think-us", [&](const string& v) { return parse_number(v, options.think_us, 0); }},
+        {"--eat-us", [&](const string& v) { return parse_number(v, options.eat_us, 0); }},
+        {"--duration-ms", [&](const string& v) { return parse_number(v, options.duration_ms, 1); }},
+        {"--meals", [&](const string& v) { return parse_number(v, options.meals, 0L); }},
+        {"--runtime", [&](const string& v) {
+            options.coroutines = v == "coroutines";
+            return v == "threads" || v == "coroutines";
+        }},
+        {"--workers", [&](const string& v) { return parse_number(v, options.workers, 1); }},
+        {"--csv", [&](const string& v) { options.csv_file = v; return true; }},
+    });
+    return options;
+}
+
+// Ячейка таблицы шириной width символов (отрицательная — выравнивание влево). printf считает
+// байты, а кириллица и тире в UTF-8 занимают по несколько байт на символ
+string table_cell(const string& text, int width) {
+    size_t length = 0;
+    for (char c : text) {
+        length += (static_cast<unsigned char>(c) & 0xC0) != 0x80; // байты продолжения не считаются
+    }
+    string padding(static_cast<size_t>(abs(width)) > length ? abs(width) - length : 0, ' ');
+    return width < 0 ? text + padding : padding + text;
+}
+
+// Строка заголовка таблицы: названия столбцов и их ширина, как в table_cell
+string table_header(initializer_list<pair<const char*, int>> columns) {
+    string line;
+    for (const auto& [title, width] : columns) {
+        if (!line.empty()) {
+            line += ' ';
+        }
+        line += table_cell(title, width);
+    }
+    return line;
+}
+
+void run_simulations(const SimOptions& options) {
+    vector<SimResult> results;
+    printf("Философы — %s\n", options.coroutines ? ("сопрограммы на " + to_string(options.workers) + " рабочих потоках").c_str() : "потоки");
+    printf("%s\n", table_header({{"стратегия", -14}, {"философы", 8}, {"обедов", 10}, {"время, с", 9}, {"обедов/с", 12},
+                                 {"Джайн", 7}, {"обедов мин–макс", 16}, {"макс. ож, мс", 12}, {"p50, мкс", 10}, {"p99, мкс", 10},
+                                 {"p999, мкс", 10}, {"переключений/с", 14}, {"байт/фил.", 10}}).c_str());
+    for (const string& name : options.strategies) {
+        SimResult r = simulate(name, options);
+        string range = table_cell(to_string(r.min_meals) + "–" + to_string(r.max_meals), 16);
+        printf("%-14s %8d %10ld %9.3f %12.0f %7.4f %s %12.3f %10.1f %10.1f %10.1f %14.0f %10.0f\n", r.strategy.c_str(), r.philosophers,
+               r.meals, r.seconds, r.meals_per_sec, r.jain, range.c_str(), r.max_wait_ns / 1e6, r.p50_ns / 1e3, r.p99_ns / 1e3, r.p999_ns / 1e3,
+               r.switches_per_sec, r.bytes_per_actor);
+        fflush(stdout);
+        results.push_back(r);
+    }
+    if (!options.csv_file.empty()) {
+        ofstream out(options.csv_file);
+        out << "strategy,runtime,philosophers,think_us,eat_us,meals,seconds,meals_per_sec,jain,min_meals,max_meals,max_wait_ns,p50_ns,p99_ns,p999_ns,switches_per_sec,bytes_per_actor\n";
+        for (const auto& r : results) {
+            out << r.strategy << ',' << r.runtime << ',' << r.philosophers << ',' << options.think_us << ',' << options.eat_us << ',' << r.meals << ','
+                << r.seconds << ',' << r.meals_per_sec << ',' << r.jain << ',' << r.min_meals << ',' << r.max_meals << ','
+                << r.max_wait_ns << ',' << r.p50_ns << ',' << r.p99_ns << ',' << r.p999_ns << ','
+                << r.switches_per_sec << ',' << r.bytes_per_actor << '\n';
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Микробенчмарки MyVector против vector: добавление, создание на месте и обход
+// при 1e3..1e8 элементов. Запуск: ./zad3 --vector-bench [--max N] [--csv файл]
+// ---------------------------------------------------------------------------
+
+template <typename T> using StdVector = vector<T>;
+template <typename T> using MyVectorX2 = MyVector<T>;
+template <typename T> using MyVectorX15 = MyVector<T, 0, ratio<3, 2>>;
+template <typename T> using MyVectorInline16 = MyVector<T, 16>;
+
+// Тривиально копируемый элемент: MyVector переносит его memcpy
+struct Point3 {
+    double x, y, z;
+    Point3(double x, double y, double z) : x(x), y(y), z(z) {}
+};
+
+volatile int64_t bench_sink; // результат, который компилятор не может выбросить
+
+// Наносекунд на элемент: fn выполняется repeats раз, каждый раз обрабатывая n элементов
+template <typename Fn>
+double ns_per_element(size_t n, size_t repeats, Fn&& fn) {
+    auto start = chrono::steady_clock::now();
+    for (size_t r = 0; r < repeats; ++r) {
+        fn();
+    }
+    chrono::duration<double, nano> duration = chrono::steady_clock::now() - start;
+    return duration.count() / (static_cast<double>(n) * repeats);
+}
+
+// Одна операция над одним видом контейнера; без reserve, чтобы сказывался рост ёмкости
+template <template <typename> class Vector>
+double bench_vector_op(const string& op, size_t n, size_t repeats) {
+    if (op == "push_back") {
+        return ns_per_element(n, repeats, [n]() {
+            Vector<int64_t> v;
+            for (size_t i = 0; i < n; ++i) {
+                v.push_back(static_cast<int64_t>(i));
+            }
+            bench_sink = v[n - 1];
+        });
+    }
+    if (op == "emplace_point") {
+        return ns_per_element(n, repeats, [n]() {
+            Vector<Point3> v;
+            for (size_t i = 0; i < n; ++i) {
+                v.emplace_back(i, i, i);
+            }
+            bench_sink = static_cast<int64_t>(v[n - 1].x);
+        });
+    }
+    if (op == "emplace_string") {
+        // Короткие строки не выделяют память, но при росте переносятся перемещением
+        return ns_per_element(n, repeats, [n]() {
+            Vector<string> v;
+            for (size_t i = 0; i < n; ++i) {
+                v.emplace_back(12, static_cast<char>('a' + i % 26));
+            }
+            bench_sink = v[n - 1][0];
+        });
+    }
+    // iterate: обход заранее заполненного массива
+    Vector<int64_t> v;
+    for (size_t i = 0; i < n; ++i) {
+        v.push_back(static_cast<int64_t>(i));
+    }
+    return ns_per_element(n, repeats, [&v]() {
+        int64_t sum = 0;
+        for (int64_t x : v) {
+            sum += x;
+        }
+        bench_sink = sum;
+    });
+}
+
+struct VectorBenchOptions {
+    size_t max_size = 10000000; // Наибольшее число элементов (до 1e8)
+    string csv_file;
+    bool valid = true;          // Ложь, если в командной строке есть ошибка
+};
+
+void run_vector_benchmarks(const VectorBenchOptions& options) {
+    const size_t work = 20000000; // Элементов на замер: малые размеры повторяются много раз
+    ofstream csv;
+    if (!options.csv_file.empty()) {
+        csv.open(options.csv_file);
+        csv << "op,size,vector_ns,myvector_x2_ns,myvector_x1_5_ns,myvector_inline16_ns\n";
+    }
+    printf("%s   (нс на элемент)\n", table_header({{"операция", -15}, {"элементов", 10}, {"vector", 12}, {"MyVector x2", 12},
+                                                   {"MyVector x1.5", 12}, {"MyVector[16]", 14}}).c_str());
+    for (const string op : {"push_back", "emplace_point", "emplace_string", "iterate"}) {
+        // Для строк (32 байта на элемент) размер ограничен 1e7, чтобы хватило памяти
+        size_t limit = op == "emplace_string" ? min<size_t>(options.max_size, 10000000) : options.max_size;
+        for (size_t n : {size_t{8}, size_t{1000}, size_t{10000}, size_t{100000}, size_t{1000000}, size_t{10000000}, size_t{100000000}}) {
+            if (n > limit) {
+                break;
+            }
+            size_t repeats = max<size_t>(1, work / n);
+            double std_ns = bench_vector_op<StdVector>(op, n, repeats);
+            double x2_ns = bench_vector_op<MyVectorX2>(op, n, repeats);
+            double x15_ns = bench_vector_op<MyVectorX15>(op, n, repeats);
+            double inline_ns = bench_vector_op<MyVectorInline16>(op, n, repeats);
+            printf("%-15s %10zu %12.3f %12.3f %12.3f %14.3f\n", op.c_str(), n, std_ns, x2_ns, x15_ns, inline_ns);
+            fflush(stdout);
+            if (csv) {
+                csv << op << ',' << n << ',' << std_ns << ',' << x2_ns << ',' << x15_ns << ',' << inline_ns << '\n';
+            }
+        }
+    }
+}
+
+const char* const vector_bench_usage = "Использование: zad3 --vector-bench [--max N] [--csv файл]\n";
+
+VectorBenchOptions parse_vector_bench_options(int argc, char* argv[]) {
+    VectorBenchOptions options;
+    options.valid = parse_option_list(argc, argv, 2, {
+        {"--max", [&](const string& v) {
+            double size = 0; // можно писать 1e8; больше 1e8 размеры всё равно не растут
+            if (!parse_number(v, size, 8.0)) {
+                return false;
+            }
+            options.max_size = static_cast<size_t>(min(size, 1e8));
+            return true;
+        }},
+        {"--csv", [&](const string& v) { options.csv_file = v; return true; }},
+    });
+    return options;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--vector-bench") {
+        VectorBenchOptions options = parse_vector_bench_options(argc, argv);
+        if (!options.valid) {
+            cerr << vector_bench_usage;
+            return 1;
+        }
+        run_vector_benchmarks(options);
+        return 0;
+    }
+    if (argc > 1) {
+        // С параметрами — измеряемая симуляция без вывода в консоль на каждом шаге
+        SimOptions options = parse_sim_options(argc, argv);
+        if (!options.valid) {
+            cerr << sim_usage;
+            return 1;
+        }
+        run_simulations(options);
+        return 0;
+    }
+
+    MyVector<thread, num_philosophers> philosophers; // вектор с философами (потоки хранятся прямо в нём)
 
     for (int i = 0; i < num_philosophers; ++i) {
-        philosophers.push_back(new thread(philosopher, i)); // создаем поток(философа) и заплняяем вектор
+        philosophers.emplace_back(philosopher, i); // создаем поток(философа) и заплняяем вектор
     }
 
-    for (size_t i = 0; i < philosophers.size(); ++i) { //запускаем потоки
-        philosophers[i]->join(); 
-        delete philosophers[i]; // освобождаем память
+    for (thread& t : philosophers) { // дожидаемся потоков
+        t.join();
     }
 
     return 0;